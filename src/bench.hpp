@@ -0,0 +1,184 @@
+/* This file is part of drvq library <http://image.ntua.gr/iva/tools/drvq>.
+   A C++ library for dimensionality-recursive vector quantization.
+
+   Copyright (c) 2013, Yannis Avrithis <iavr@image.ntua.gr>.
+   All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without modification,
+   are permitted provided that the following conditions are met:
+
+   * Redistributions of source code must retain the above copyright notice, this
+     list of conditions and the following disclaimer.
+
+   * Redistributions in binary form must reproduce the above copyright notice, this
+     list of conditions and the following disclaimer in the documentation and/or
+     other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+   ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+   WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+   ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+   ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
+
+
+//-----------------------------------------------------------------------------
+
+#ifndef BENCH_HPP
+#define BENCH_HPP
+
+#include "options/bench.hpp"
+
+namespace drvq {
+
+using namespace ivl;
+using namespace std;
+
+//-----------------------------------------------------------------------------
+
+// propagation on the grid of a trained node, given data to populate it
+template <typename T>
+class bencher
+{
+	typedef typename train_tree <T>::lab lab;        // label type
+	typedef typename train_tree <T>::pos pos;        // position type
+	typedef typename train_tree <T>::count count;    // count type
+	typedef typename tree <T>::data data;            // data type
+	typedef sample_search_generator <count, pos> generator;  // random generator type
+	typedef bin_record <T, lab, count> record;             // per-bin record type
+
+	const bench_options& opt;  // options
+	int layout;                // grid layout
+	tree <T> *child0, *child1; // children
+	size_t K, J;               // number of centroids, children centroids
+	array <lab> code0, code1;  // positions of centroids on grid
+	array_2d <T> dist0, dist1; // centroid distances to children centroids
+	size_array dom;            // non-empty bins
+	array <count> d_pop;       // population per non-empty bin
+
+//-----------------------------------------------------------------------------
+
+	template <int Q, typename TERM>
+	double run(const TERM term)
+	{
+		array_2d <lab> source(J, J);
+		tile_grid <record> bins;
+		bins.init(J);
+		bin_layout(bins, layout, opt.range,
+		           child0 -> edges(), child0 -> weights(),
+		           child1 -> edges(), child1 -> weights());
+		for (size_t i = 0; i < dom.length(); i++)
+			bins[dom[i]].pop = d_pop[i];
+		array <array <lab> > edge(K);
+		array <array <T> > weight(K);
+		array <lab> c0 = code0, c1 = code1;
+		tile_grid <char> chosen;
+		chosen.init(J, false);
+		for (size_t k = 0; k < K; k++)
+			chosen(c0[k], c1[k]) = true;
+		generator gen = sample_search(dom, d_pop, opt.seed);
+
+		timer t;
+		t.tic();
+		prop <T, lab, pos, count, Q>
+			P(source, bins, edge, weight,
+			  c0, c1, dist0, dist1,
+			  child0 -> edges(), child1 -> edges(),
+			  child0 -> weights(), child1 -> weights(),
+			  opt);
+		P(gen, chosen, term, false);
+		return t.toc();
+	}
+
+	template <int Q, typename TERM>
+	double best(const TERM term)
+	{
+		double time = run <Q>(term);
+		for (size_t r = 1; r < opt.repeat; r++)
+			time = std::min(time, run <Q>(term));
+		return time;
+	}
+
+//-----------------------------------------------------------------------------
+
+public:
+
+	bencher(root <T>* book, const data& X, const bench_options& opt) :
+		opt(opt), layout(opt.layout)
+	{
+		size_t c = std::min(opt.codebook, book->children() - 1);
+		size_array at = book->dims(c);
+		node <T>* n = dynamic_cast <node <T>*>(book->book(c));
+		msg::require(check, n, "codebook has no nodes");
+		for (size_t l = 0; l < opt.depth; l++)
+		{
+			node <T>* m = dynamic_cast <node <T>*>(n->children(0));
+			if (!m) break;
+			size_array sub = at[n->dims(0)];
+			at = sub;
+			n = m;
+		}
+		child0 = n->children(0);
+		child1 = n->children(1);
+		const size_array at0 = at[n->dims(0)], at1 = at[n->dims(1)];
+		K = n->size();
+		J = child0->size();
+		msg::level(info, log2_(at.length()), at, K, J, false);
+		msg::nl(info);
+
+		// centroids as data
+		data cen(book->dims());
+		for (size_t d = 0; d < cen.length(); d++)
+			cen[d].init(K);
+		n->flat(cen, at, (0, _, K - 1));
+
+		// quantize centroids, as in training
+		dist0 = child0->dist2(cen, at0);
+		dist1 = child1->dist2(cen, at1);
+		code0.init(K);
+		code1.init(K);
+		for (size_t k = 0; k < K; k++)
+		{
+			code0[k] = arg_min(dist0.as_rows()[k]);
+			code1[k] = arg_min(dist1.as_rows()[k]);
+		}
+
+		// quantize data points into bins
+		tile_grid <count> b_pop;
+		b_pop.init(J, count(0));
+		array <pos> code =
+			cast <pos>(child0->quant(X, at0)) +
+			J * cast <pos>(child1->quant(X, at1));
+		for (size_t n = 0; n < code.length(); n++)
+			b_pop[code[n]]++;
+		dom = b_pop.find();
+		d_pop.init(dom.length());
+		for (size_t i = 0; i < dom.length(); i++)
+			d_pop[i] = b_pop[dom[i]];
+		msg::disp(info, "non-empty bins: ", dom.length());
+	}
+
+//-----------------------------------------------------------------------------
+
+	// grid layout of following measurements
+	void use(const int l) { layout = l; }
+
+	template <int Q>
+	void measure(const string& name)
+	{
+		msg::head(info, name, "");
+		msg::time(info, "iteration pass", best <Q>(types::t_false()));
+		msg::time(info, "terminating pass", best <Q>(types::t_true()));
+	}
+
+};
+
+//-----------------------------------------------------------------------------
+
+}  // namespace drvq
+
+#endif  // BENCH_HPP
@@ -30,6 +30,10 @@
 #ifndef IO_FILES_HPP
 #define IO_FILES_HPP
 
+#include <cstdio>
+#include <fstream>
+#include <unistd.h>
+
 namespace drvq {
 
 using namespace ivl;
@@ -203,6 +207,127 @@ load_data(const O& opt, const string& name)
 
 //-----------------------------------------------------------------------------
 
+// data files of a list, loaded one at a time in repeated passes, so that
+// only one file is in memory at a time
+template <typename T>
+class data_stream
+{
+	typedef array <T> point;
+	typedef array <array <T> > data;
+
+	string path, ext;      // data path, file extension
+	array <string> names;  // file names
+	size_t D;              // dimensions
+	size_t f;              // next file
+
+public:
+
+	template <typename O>
+	data_stream(const O& opt) :
+		path(opt.path), ext(opt.ext), names(load_lines(opt.list)), D(0), f(0)
+	{
+		if (!opt.files) names.init();
+		if (opt.files > 0 && names.length() > size_t(opt.files))
+			names = names[0, _, opt.files - 1];
+		if (names.empty()) return;
+		size_array sz = load_array_size <point> (path + '/' + names[0] + '.' + ext);
+		D = sz.empty() ? 0 : sz[1];
+	}
+
+	// keep files i, i + n, i + 2n, ... only, out of n shards
+	void shard(const size_t i, const size_t n)
+	{
+		if (n < 2) return;
+		array <string> keep;
+		for (size_t f = i; f < names.length(); f += n)
+			keep.push_back(names[f]);
+		names = keep;
+	}
+
+	size_t files() const { return names.length(); }
+
+	size_t dims() const { return D; }
+
+	size_t size() const
+	{
+		return names.empty() ? 0 : sum(view_sizes <T>(path, names, ext));
+	}
+
+	// restart pass
+	void rewind() { f = 0; }
+
+	// load next non-empty file of pass into X; false at end of pass
+	bool next(data& X)
+	{
+		while (f < names.length())
+		{
+			msg::progress(info, f, names.length());
+			X = load_data <T>(path, names[f++], ext);
+			if (!X.empty()) return true;
+		}
+		return false;
+	}
+};
+
+//-----------------------------------------------------------------------------
+
+// exchange of files between processes through a shared directory; a file is
+// written under a temporary name and renamed when complete, and a reader
+// waits until it appears, failing after a timeout. Names are never reused
+// within a run and are prefixed by the run id, so files left over by an
+// earlier run under another id are never read as current
+class file_exchange
+{
+	string dir;      // shared directory
+	string run;      // run id, common to all processes of a run
+	size_t timeout;  // maximum wait per file in seconds; 0: no limit
+
+public:
+
+	file_exchange(const string& dir, const string& run = "",
+	              const size_t timeout = 0) :
+		dir(dir), run(run), timeout(timeout) { }
+
+	string name(const string& tag, const size_t i) const
+	{
+		return dir + '/' + (run.empty() ? "" : run + '.') +
+		       tag + '.' + to_<string>(i);
+	}
+
+	// write file (tag, i) by w(stream)
+	template <typename W>
+	void put(const string& tag, const size_t i, W& w) const
+	{
+		const string file = name(tag, i), temp = file + ".part";
+		{
+			std::ofstream s(temp.c_str(), std::ios::binary);
+			msg::require(check, s.is_open(), "cannot write " + temp);
+			w(s);
+		}
+		msg::require(check, !std::rename(temp.c_str(), file.c_str()),
+		             "cannot write " + file);
+	}
+
+	// wait for file (tag, i) and read it by r(stream)
+	template <typename R>
+	void get(const string& tag, const size_t i, R& r) const
+	{
+		const string file = name(tag, i);
+		std::ifstream s;
+		for (size_t t = 0, T = 10 * timeout; ; t++)  // polled every 0.1s
+		{
+			s.open(file.c_str(), std::ios::binary);
+			if (s.is_open()) break;
+			s.clear();
+			msg::require(check, !T || t < T, "timed out waiting for " + file);
+			usleep(100000);
+		}
+		r(s);
+	}
+};
+
+//-----------------------------------------------------------------------------
+
 }  // namespace drvq
 
 #endif  // IO_FILES_HPP
@@ -53,6 +53,9 @@ namespace msg {
 typedef types::t_true yes;
 typedef types::t_false no;
 
+// serializes messages of concurrent threads, one call at a time
+thread_mutex serial(true);
+
 //-----------------------------------------------------------------------------
 
 template <typename T>
@@ -62,6 +65,7 @@ template <typename T>
 void require(yes, const T& x, const string& message)
 {
 	if (x) return;
+	thread_lock l(serial);
 	cerr << endl << bright << "error: " << message << "... aborting" <<
 		normal << endl << endl;
 	exit(0);
@@ -81,6 +85,7 @@ void load_fail(yes, const std::string& filename)
 void disp(no,  const string& message) { }
 void disp(yes, const string& message)
 {
+	thread_lock l(serial);
 	cout << message << endl;
 }
 
@@ -90,6 +95,7 @@ void disp(no,  const string& pre, const T& x, const string& post = "") { }
 template <typename T>
 void disp(yes, const string& pre, const T& x, const string& post = "")
 {
+	thread_lock l(serial);
 	cout << pre << x << post << endl;
 }
 
@@ -99,12 +105,14 @@ void head(no,  const string& pre, const T& x, const string& post = "") { }
 template <typename T>
 void head(yes, const string& pre, const T& x, const string& post = "")
 {
+	thread_lock l(serial);
 	cout << bright << pre << x << post << normal << endl;
 }
 
 void in_line(no,  const string& message) { }
 void in_line(yes, const string& message)
 {
+	thread_lock l(serial);
 	cout << message;
 	cout.flush();
 }
@@ -115,6 +123,7 @@ void in_line(no,  const string& pre, const T& x, const string& post = "") { }
 template <typename T>
 void in_line(yes, const string& pre, const T& x, const string& post = "")
 {
+	thread_lock l(serial);
 	cout << pre << x << post;
 	cout.flush();
 }
@@ -122,6 +131,7 @@ void in_line(yes, const string& pre, const T& x, const string& post = "")
 void nl(no,  bool detail = true) { }
 void nl(yes, bool detail = true)
 {
+	thread_lock l(serial);
 	if (detail) cout << endl;
 	else cout.flush();
 }
@@ -132,6 +142,7 @@ void param(no,  const ARG& arg) { }
 template <typename ARG>
 void param(yes, const ARG& arg, const string& head = "parameters: ")
 {
+	thread_lock l(serial);
 	cout << head << endl;
 	arg.display();
 }
@@ -141,6 +152,7 @@ void param(yes, const ARG& arg, const string& head = "parameters: ")
 void dot(no) { }
 void dot(yes)
 {
+	thread_lock l(serial);
 	cout << ".";
 	cout.flush();
 }
@@ -148,30 +160,34 @@ void dot(yes)
 void progress(no,  size_t i, size_t total) { }
 void progress(yes, size_t i, size_t total)
 {
-	if ((i % (total / 20)) == 0) dot(yes());
+	if (total < 20 || (i % (total / 20)) == 0) dot(yes());
 }
 
 void percent(no,  const string& message, size_t n, size_t N) { }
 void percent(yes, const string& message, size_t n, size_t N)
 {
+	thread_lock l(serial);
 	cout << message << " (" << 100. * n / N << "%)" << endl;
 }
 
 void percent(no,  size_t i, const string& message, size_t n, size_t N) { }
 void percent(yes, size_t i, const string& message, size_t n, size_t N)
 {
+	thread_lock l(serial);
 	cout << i << " " << message << " (" << 100. * n / N << "%)" << endl;
 }
 
 void done(no) { }
 void done(yes)
 {
+	thread_lock l(serial);
 	cout << " done" << endl;
 }
 
 void test(no) { }
 void test(yes, bool ok)
 {
+	thread_lock l(serial);
 	cout << bright << " " << (ok ? "OK" : "FAIL") << normal << endl;
 }
 
@@ -180,6 +196,7 @@ void test(yes, bool ok)
 void time(no,  const string& message, double t) { }
 void time(yes, const string& message, double t)
 {
+	thread_lock l(serial);
 	cout << message << " " << bright << t / 1000 << normal << " s" << endl;
 }
 
@@ -189,6 +206,7 @@ void avg_time(no,  const string& message, double t_file,
 void avg_time(yes, const string& message, double t_file,
 				  const string& file_name = "file")
 {
+	thread_lock l(serial);
 	cout << message << " " << bright << t_file << normal << " ms/" <<
 		file_name << endl;
 }
@@ -200,6 +218,7 @@ void avg_time(no,  const string& message, double t_file, double t_point,
 void avg_time(yes, const string& message, double t_file, double t_point,
 				  const string& file_name = "file", const string pt_name = "point")
 {
+	thread_lock l(serial);
 	cout << message << " " <<
 		bright << t_file << normal << " ms/" << file_name << ", " <<
 		bright << t_point * 1000 << normal << " us/" << pt_name << endl;
@@ -210,12 +229,14 @@ void avg_time(yes, const string& message, double t_file, double t_point,
 void data(no,  size_t F, size_t N) { }
 void data(yes, size_t F, size_t N)
 {
+	thread_lock l(serial);
 	cout << F << " files, " << N << " points" << endl;
 }
 
 void data(no,  size_t F, size_t N, size_t D) { }
 void data(yes, size_t F, size_t N, size_t D)
 {
+	thread_lock l(serial);
 	cout << F << " files, " << N << " points, " << D << " dimensions" << endl;
 }
 
@@ -225,6 +246,7 @@ void data(no,  size_t F, const array <array <T> >& X) { }
 template <typename T>
 void data(yes, size_t F, const array <array <T> >& X)
 {
+	thread_lock l(serial);
 	size_t D = X.length();
 	size_t N = D ? X[0].length() : 0;
 	data(yes(), F, N, D);
@@ -235,6 +257,7 @@ void data(yes, size_t F, const array <array <T> >& X)
 void capacity(no,  const size_array& cap) { }
 void capacity(yes, const size_array& cap)
 {
+	thread_lock l(serial);
 	cout << "capacity (codebook size), for levels 0-" <<
 		cap.length() - 1 << ": " << bright << cap << normal << endl;
 }
@@ -244,6 +267,7 @@ void capacity(yes, const size_array& cap)
 void mid(no,  const size_array& mid) { }
 void mid(yes, const size_array& mid)
 {
+	thread_lock l(serial);
 	if (any(diff(mid) == 0))
 		cout << "--> midpoint collision" << endl;
 }
@@ -256,6 +280,7 @@ void level(no,  size_t L, const size_array& at, size_t K, size_t J,
 void level(yes, size_t L, const size_array& at, size_t K, size_t J,
 			  bool detail)
 {
+	thread_lock l(serial);
 	if (detail) cout << bright;
 	cout << "level " << L;
 	if (detail) cout << normal;
@@ -266,13 +291,19 @@ void level(yes, size_t L, const size_array& at, size_t K, size_t J,
 void iter(no,  size_t it) { }
 void iter(yes, size_t it)
 {
+	thread_lock l(serial);
 	cout << "iteration " << it;
 	cout.flush();
 }
 
-void term(no,  size_t it) { }
-void term(yes, size_t it)
+// whole level line at once, so that concurrent nodes do not interleave
+void term(no,  size_t L, const size_array& at, size_t K, size_t J,
+			 size_t it) { }
+void term(yes, size_t L, const size_array& at, size_t K, size_t J,
+			 size_t it)
 {
+	thread_lock l(serial);
+	level(yes(), L, at, K, J, false);
 	cout << " - " << it << " iterations" << endl;
 }
 
@@ -284,6 +315,7 @@ void edge(no,  const array <array <T> >& weight, double range) { }
 template <typename T>
 void edge(yes, const array <array <T> >& weight, double range)
 {
+	thread_lock l(serial);
 	size_t K = weight.length();
 	size_array degree(K), pruned(K);
 	for(size_t k = 0; k < K; k++)
@@ -304,6 +336,7 @@ template <typename L, typename S1, typename S2>
 bool zero(yes, size_t K, const array <L, S1>& source,
 			 const array <L, S2>& b_pop)
 {
+	thread_lock l(serial);
 	size_array pop(K, size_t(0));
 	pop[source] += b_pop;
 	size_array z = find(!pop);
@@ -325,6 +358,7 @@ void max_update(yes, T& max_val, T cur_val)
 void queue(no,  size_t queue_length, size_t heap_length) { }
 void queue(yes, size_t queue_length, size_t heap_length)
 {
+	thread_lock l(serial);
 	if (heap_length)
 		cout << " queue / heap length " << queue_length << " / " <<
 			heap_length << endl;
@@ -332,22 +366,53 @@ void queue(yes, size_t queue_length, size_t heap_length)
 		cout << " queue length " << queue_length << endl;
 }
 
-void collide(no,  const array_2d <size_t>& state, size_t p, size_t alive,
-				 size_t k) { }
-void collide(yes, const array_2d <size_t>& state, size_t p, size_t alive,
-				 size_t k)
+void tiles(no,  size_t touched, size_t total, size_t bytes) { }
+void tiles(yes, size_t touched, size_t total, size_t bytes)
+{
+	thread_lock l(serial);
+	cout << " grid tiles touched / total " << touched << " / " << total <<
+		" (" << bytes / double(1 << 20) << " MB)" << endl;
+}
+
+void distortion(no,  double dist, size_t changed, size_t n) { }
+void distortion(yes, double dist, size_t changed, size_t n)
+{
+	thread_lock l(serial);
+	cout << " distortion " << dist << ", " << changed << "/" << n <<
+		" bins changed" << endl;
+}
+
+void grid(no,  size_t level, size_t side) { }
+void grid(yes, size_t level, size_t side)
+{
+	thread_lock l(serial);
+	if (level) cout << " grid level " << level << ", " << side << "x" <<
+		side << " bins" << endl;
+	else cout << " full grid" << endl;
+}
+
+void moved(no,  size_t moved, size_t K) { }
+void moved(yes, size_t moved, size_t K)
+{
+	thread_lock l(serial);
+	cout << ", " << moved << "/" << K << " centroids moved ";
+	cout.flush();
+}
+
+void collide(no,  size_t state, size_t alive, size_t k) { }
+void collide(yes, size_t state, size_t alive, size_t k)
 {
-	if (state[p] != alive) cout << bright << "--> centroid " << k <<
+	thread_lock l(serial);
+	if (state != alive) cout << bright << "--> centroid " << k <<
 		" collided" << normal << endl;
 }
 
-void visit(no,  const array_2d <size_t>& state, size_t burnt, bool term) { }
-void visit(yes, const array_2d <size_t>& state, size_t burnt,
-			  const array_2d <size_t>& target, bool term)
+void visit(no,  size_t bad, size_t B, bool term) { }
+void visit(yes, size_t bad, size_t B, bool term)
 {
-	size_t bad = ivl::find(target && state != burnt).length();  // TODO: count
+	thread_lock l(serial);
 	if (!bad) return;
-	cout << bright << "--> " << bad << "/" << state.length() << " bins alive";
+	cout << bright << "--> " << bad << "/" << B << " bins alive";
 	if (term) cout << " at termination";
 	cout << normal << endl;
 }
@@ -357,6 +422,7 @@ void visit(yes, const array_2d <size_t>& state, size_t burnt,
 void book(no,  size_t D, size_t C, size_t J, size_t B) { }
 void book(yes, size_t D, size_t C, size_t J, size_t B)
 {
+	thread_lock l(serial);
 	cout << D << " dimensions, " << C << " codebooks, " <<
 		J << "^" << C << " grid, " << B << " bins" << endl;
 }
@@ -366,6 +432,7 @@ void book(yes, size_t D, size_t C, size_t J, size_t B)
 void index(no,  size_t F, size_t N, size_t B, size_t E) { }
 void index(yes, size_t F, size_t N, size_t B, size_t E)
 {
+	thread_lock l(serial);
 	cout << F << " files, " << N << " points, " <<
 		B << " bins (" << double(E) / B * 100 << "% non-empty)" << endl;
 	cout << "average non-empty bin size: " << N / double(E) << endl;
@@ -374,6 +441,7 @@ void index(yes, size_t F, size_t N, size_t B, size_t E)
 void index(no,  size_t N, size_t B, size_t E) { }
 void index(yes, size_t N, size_t B, size_t E)
 {
+	thread_lock l(serial);
 	cout << "total bins: " << B << endl;
 	cout << "non-empty bins: " <<
 		E << " (" << double(E) / B * 100 << "%)" << endl;
@@ -388,6 +456,7 @@ void rank(no,  T rank, size_t J) { }
 template <typename T>
 void rank(yes, T rank, size_t J)
 {
+	thread_lock l(serial);
 	cout << "avg rank: " << bright << rank << normal << " out of " << J << endl;
 }
 
@@ -397,6 +466,7 @@ void bounds(no,  T lower, T approx, T upper) { }
 template <typename T>
 void bounds(yes, T lower, T approx, T upper)
 {
+	thread_lock l(serial);
 	cout << "distance: min " << lower << ", approx " <<
 		bright << approx << normal << ", max " << upper << endl;
 }
@@ -407,6 +477,7 @@ void recall(no,  const array <T1, S1>& at, const array <T2, S2>& rec) { }
 template <typename T1, typename S1, typename T2, typename S2>
 void recall(yes, const array <T1, S1>& at, const array <T2, S2>& rec)
 {
+	thread_lock l(serial);
 	cout << !wrap << "recall @ " << at << ":" << endl <<
 		"         " << bright << rec << normal << endl;
 }
@@ -417,6 +488,7 @@ void ratio(no,  const array <T1, S1>& rat, const array <T2, S2>& freq) { }
 template <typename T1, typename S1, typename T2, typename S2>
 void ratio(yes, const array <T1, S1>& rat, const array <T2, S2>& freq)
 {
+	thread_lock l(serial);
 	cout << !wrap << "ratio at " << rat << ":" << endl <<
 		"         " << bright << freq << normal << endl;
 }
@@ -429,6 +501,7 @@ void query(no,  const string& name, size_t id, size_t relevant,
 void query(yes, const string& name, size_t id, size_t relevant,
 			  size_t window = -1)
 {
+	thread_lock l(serial);
 	if (window != -1)
 		cout << "top " << window << " ";
 	cout << "results for query " << bright << name << normal <<
@@ -445,6 +518,7 @@ void result(yes, const array <string>& search_list, const size_array& id,
 				const array <T>& score, const size_array& votes,
 				const set <string>& good, size_t window = -1)
 {
+	thread_lock l(serial);
 	window = min(window, id.length());
 	cout << "# R query name [id] (score / votes)" << endl;
 	for (size_t n = 0, r = 0; n < window; n++)
@@ -470,6 +544,7 @@ void result(yes, const array <string>& search_list, const size_array& id,
 void eval_ranks(no,  size_t Q, size_t F) { }
 void eval_ranks(yes, size_t Q, size_t F)
 {
+	thread_lock l(serial);
 	cout << Q << " queries, " << F << " files" << endl;
 }
 
@@ -479,6 +554,7 @@ void eval_map(no,  const array <T>& ap) { }
 template <typename T>
 void eval_map(yes, const array <T>& ap)
 {
+	thread_lock l(serial);
 	cout << "mean average precision: " << bright << mean(ap) << normal << endl;
 }
 
@@ -490,6 +566,7 @@ template <typename T>
 void eval_pr(yes, const size_array& at, const array <array <T> >& precision,
 				 const array <array <T> >& recall)
 {
+	thread_lock l(serial);
 	size_t Q = precision.length();
 	array <T> P(at.length(), T()), R(at.length(), T());
 	for (size_t q = 0; q < Q; q++)  // TODO: mean(precision), mean(recall)
@@ -508,6 +585,7 @@ void eval_ap(no,  const array <T>& ap, const array <string>& queries) { }
 template <typename T>
 void eval_ap(yes, const array <T>& ap, const array <string>& queries)
 {
+	thread_lock l(serial);
 	cout << "# query - ap" << endl;
 	for (size_t q = 0; q < queries.length(); q++)
 	{
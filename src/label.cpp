@@ -59,6 +59,10 @@ void label(const label_options& opt = label_options())
 	msg::require(check, book, "empty codebooks");
 	msg::done(info);
 	msg::book(info, book->dims(), C, book->side(), book->bins());
+	if (opt.method == label_options::fast)
+		book->compile(opt.tiled, true);
+	if (opt.method == label_options::exact && opt.expand)
+		book->expand();
 	if (opt.method == label_options::approx)
 		for (size_t c = 0; c < C; c++)
 		{
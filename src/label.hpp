@@ -41,6 +41,75 @@ using namespace std;
 
 //-----------------------------------------------------------------------------
 
+// load, normalize and label file f of a labeler L
+template <typename T, typename L>
+struct label_task : public task
+{
+	L* lab;
+	const root <T>* book;
+	const label_options* opt;
+	string name;  // file name
+	size_t f;     // file index
+	size_t n;     // number of points
+
+	void run()
+	{
+		typename tree <T>::data X = load_data <T>(*opt, name);
+		normalize(X, *opt);
+		n = X.empty() ? 0 : X[0].length();
+		if (n) lab->label(book, X, *opt, f);
+	}
+};
+
+// label files on opt.threads threads, with up to two files per thread in
+// flight; files are committed in order by the calling thread, which reports
+// progress, and results are stored per file, so they are identical to those
+// of a serial run. Returns the total number of points; t measures loading
+// and labeling together
+template <typename T, typename L>
+size_t label_files(L& lab, const root <T>* book, const label_options& opt,
+                   const array <string>& names, timer& t)
+{
+	const size_t F = names.length();
+	task_pool pool(opt.threads);
+	const size_t W = 2 * pool.threads();  // files in flight
+	label_task <T, L>* slot = new label_task <T, L>[W];
+	size_t N = 0;
+
+	t.tic();
+	for (size_t f = 0; f < F + W; f++)
+	{
+		// commit file g, freeing its slot for file f
+		const size_t g = f - W;
+		if (f >= W && g < F)
+		{
+			label_task <T, L>& k = slot[g % W];
+			pool.sync(k);
+			opt.brief() ? msg::progress(info, g, F) :
+			              msg::percent(info, g, names[g], g, F);
+			N += k.n;
+		}
+
+		if (f < F)
+		{
+			label_task <T, L>& k = slot[f % W];
+			k.lab = &lab;
+			k.book = book;
+			k.opt = &opt;
+			k.name = names[f];
+			k.f = f;
+			k.n = 0;
+			pool.spawn(k);
+		}
+	}
+	t.tac();
+
+	delete[] slot;
+	return N;
+}
+
+//-----------------------------------------------------------------------------
+
 template <typename T, bool DIST = true>
 class labeler : public iofile <labeler <T, DIST>, true>
 {
@@ -90,6 +159,11 @@ public:
 		F = names.length();
 		labels.init(F);
 		distortion.init(F);
+		if (opt.threads > 1)
+		{
+			N = label_files(*this, book, opt, names, t);
+			return;
+		}
 		for (size_t f = 0; f < F; f++)
 		{
 			opt.brief() ? msg::progress(info, f, F) :
@@ -99,11 +173,18 @@ public:
 			if (X.empty()) continue;
 			N += X[0].length();
 			t.tic();
-			(_, labels[f], distortion[f]) = label(book, X, opt);
+			label(book, X, opt, f);
 			t.tac();
 		}
 	}
 
+	// label points X of file f
+	void label(const root <T>* book, const data& X,
+	           const label_options& opt, const size_t f)
+	{
+		(_, labels[f], distortion[f]) = label(book, X, opt);
+	}
+
 //-----------------------------------------------------------------------------
 
 	size_t files()  const { return F; }
@@ -203,6 +284,11 @@ public:
 		msg::require(check, !names.empty(), "empty data file list");
 		F = names.length();
 		labels.init(F);
+		if (opt.threads > 1)
+		{
+			N = label_files(*this, book, opt, names, t);
+			return;
+		}
 		for (size_t f = 0; f < F; f++)
 		{
 			opt.brief() ? msg::progress(info, f, F) :
@@ -212,11 +298,18 @@ public:
 			if (X.empty()) continue;
 			N += X[0].length();
 			t.tic();
-			labels[f] = label(book, X, opt);
+			label(book, X, opt, f);
 			t.tac();
 		}
 	}
 
+	// label points X of file f
+	void label(const root <T>* book, const data& X,
+	           const label_options& opt, const size_t f)
+	{
+		labels[f] = label(book, X, opt);
+	}
+
 //-----------------------------------------------------------------------------
 
 	size_t files()  const { return F; }
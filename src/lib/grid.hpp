@@ -0,0 +1,291 @@
+/* This file is part of drvq library <http://image.ntua.gr/iva/tools/drvq>.
+   A C++ library for dimensionality-recursive vector quantization.
+
+   Copyright (c) 2013, Yannis Avrithis <iavr@image.ntua.gr>.
+   All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without modification,
+   are permitted provided that the following conditions are met:
+
+   * Redistributions of source code must retain the above copyright notice, this
+     list of conditions and the following disclaimer.
+
+   * Redistributions in binary form must reproduce the above copyright notice, this
+     list of conditions and the following disclaimer in the documentation and/or
+     other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+   ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+   WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+   ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+   ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
+
+
+//-----------------------------------------------------------------------------
+
+#ifndef LIB_GRID_HPP
+#define LIB_GRID_HPP
+
+#include <vector>
+#include "thread.hpp"
+
+//-----------------------------------------------------------------------------
+
+namespace ivl {
+
+//-----------------------------------------------------------------------------
+// square grid addressed like array_2d, by column-major offset or by row and
+// column, but stored as square tiles that are only allocated on first
+// non-const access; const access to an unallocated tile yields the default
+// value. Memory thus grows with the area actually touched rather than with
+// the grid size. Elements within tiles may be stored in Morton (Z) order,
+// and rows and columns may be relabeled, so that elements that are accessed
+// together are stored close together. Tiles may be taken from and returned
+// to a buffer pool, so that grids of equal type share them over time.
+
+template <typename T>
+class tile_grid
+{
+	enum { B = 4, S = 1 << B, M = S - 1, A = S * S };  // tile side bits, side, mask, area
+	enum { batch = 16 };  // tiles taken from pool at a time
+
+	size_t J;              // grid side
+	size_t N;              // tiles per side
+	size_t L;              // log2(J) if J is a power of two, else 0
+	T def;                 // default value
+	std::vector <T*> tile; // tiles, or null if unallocated
+	size_t used;           // number of allocated tiles
+	buffer_pool* pool;     // source of tiles, if any
+	std::vector <T*> reserve;  // tiles taken from pool, not yet used
+
+	// layout
+	bool z;                           // Morton order within tiles?
+	std::vector <size_t> row, col;    // stored row / column per label, if relabeled
+	std::vector <size_t> irow, icol;  // label per stored row / column
+
+//-----------------------------------------------------------------------------
+
+	// 4 bits to even bit positions, and back
+	static size_t spread(size_t x) { x = (x | x << 2) & 0x33; return (x | x << 1) & 0x55; }
+	static size_t merge(size_t x)  { x &= 0x55; x = (x | x >> 1) & 0x33; return (x | x >> 2) & 0x0f; }
+
+	void split(const size_t p, size_t& r, size_t& c) const
+	{
+		if (L) { r = p & (J - 1); c = p >> L; }
+		else   { r = p % J;       c = p / J; }
+	}
+
+	void place(size_t& r, size_t& c) const
+	{
+		if (!row.empty()) { r = row[r]; c = col[c]; }
+	}
+
+	size_t at(const size_t r, const size_t c) const
+	{
+		return (r >> B) + N * (c >> B);
+	}
+
+	size_t in(const size_t r, const size_t c) const
+	{
+		return z ? spread(r & M) | spread(c & M) << 1 : (r & M) + S * (c & M);
+	}
+
+	// offset of element i of tile t, or length() if outside grid
+	size_t offset(const size_t t, const size_t i) const
+	{
+		size_t r = (t % N) << B, c = (t / N) << B;
+		if (z) { r += merge(i); c += merge(i >> 1); }
+		else   { r += i & M;    c += i >> B; }
+		if (r >= J || c >= J) return J * J;
+		if (!row.empty()) { r = irow[r]; c = icol[c]; }
+		return r + J * c;
+	}
+
+	T* make(const size_t t)
+	{
+		if (pool && reserve.empty()) pool->acquire(reserve, batch, A * sizeof(T));
+		T* x = pool ? reserve.back() : new T[A];
+		if (pool) reserve.pop_back();
+		for (size_t i = 0; i < A; i++)
+			x[i] = def;
+		used++;
+		return tile[t] = x;
+	}
+
+	T get(size_t r, size_t c) const
+	{
+		place(r, c);
+		const T* x = tile[at(r, c)];
+		return x ? x[in(r, c)] : def;
+	}
+
+	T& ref(size_t r, size_t c)
+	{
+		place(r, c);
+		const size_t t = at(r, c);
+		T* x = tile[t];
+		return (x ? x : make(t))[in(r, c)];
+	}
+
+//-----------------------------------------------------------------------------
+
+public:
+
+	typedef T elem_type;
+
+	tile_grid() : J(0), N(0), L(0), def(), used(0), pool(0), z(false) { }
+	tile_grid(const tile_grid& g) : J(0), N(0), L(0), def(), used(0), pool(0), z(false) { *this = g; }
+	~tile_grid() { init(0, T()); }
+
+	tile_grid& operator=(const tile_grid& g)
+	{
+		if (&g == this) return *this;
+		init(g.J, g.def);
+		z = g.z;
+		row = g.row; col = g.col;
+		irow = g.irow; icol = g.icol;
+		for (size_t t = 0; t < tile.size(); t++)
+			if (g.tile[t])
+			{
+				T* x = make(t);
+				for (size_t i = 0; i < A; i++)
+					x[i] = g.tile[t][i];
+			}
+		return *this;
+	}
+
+	// J x J grid with all elements equal to d, in default layout
+	void init(const size_t side, const T& d = T())
+	{
+		if (pool && used) pool->release(tile, A * sizeof(T));
+		else if (!pool)
+			for (size_t t = 0; t < tile.size(); t++)
+				delete[] tile[t];
+		if (pool && !reserve.empty()) pool->release(reserve, A * sizeof(T));
+		reserve.clear();
+		J = side;
+		N = (J + M) >> B;
+		L = J > 1 && !(J & (J - 1)) ? log2_(J) : 0;
+		def = d;
+		used = 0;
+		std::vector <T*>(N * N, (T*) 0).swap(tile);
+		z = false;
+		row.clear(); col.clear();
+		irow.clear(); icol.clear();
+	}
+
+	// same, given dimensions as for array_2d; must be square
+	void init(const size_array& sz, const T& d = T())
+	{
+		init(sz.length() ? sz[0] : 0, d);
+	}
+
+//-----------------------------------------------------------------------------
+
+	// take tiles from and return them to pool p, or allocate them if null;
+	// tiles are taken in batches, so the pool is locked once per batch. Kept
+	// over init(), for plain types T only, and only while no tile is
+	// allocated
+	void recycle(buffer_pool* p)
+	{
+		(void) sizeof(typename pool_plain <T>::check);
+		pool = p;
+	}
+
+	// Morton order within tiles; only while no tile is allocated
+	void morton(const bool m = true) { z = m; }
+
+	// store each row label r at row r_at[r] and each column label c at column
+	// c_at[c]; both are permutations of 0..J-1; only while no tile is
+	// allocated
+	void relabel(const size_array& r_at, const size_array& c_at)
+	{
+		row.assign(J, 0); col.assign(J, 0);
+		irow.assign(J, 0); icol.assign(J, 0);
+		for (size_t j = 0; j < J; j++)
+		{
+			irow[row[j] = r_at[j]] = j;
+			icol[col[j] = c_at[j]] = j;
+		}
+	}
+
+//-----------------------------------------------------------------------------
+
+	size_t length()  const { return J * J; }
+	size_t rows()    const { return J; }
+	size_t columns() const { return J; }
+
+	// allocated tiles, all tiles, and memory in bytes
+	size_t tiles()    const { return used; }
+	size_t capacity() const { return tile.size(); }
+	size_t bytes() const { return used * A * sizeof(T) + tile.size() * sizeof(T*); }
+
+//-----------------------------------------------------------------------------
+
+	T operator[](const size_t p) const
+	{
+		size_t r, c;
+		split(p, r, c);
+		return get(r, c);
+	}
+
+	T& operator[](const size_t p)
+	{
+		size_t r, c;
+		split(p, r, c);
+		return ref(r, c);
+	}
+
+	T operator()(const size_t r, const size_t c) const { return get(r, c); }
+	T& operator()(const size_t r, const size_t c) { return ref(r, c); }
+
+//-----------------------------------------------------------------------------
+
+	// call f(p, x) for each allocated element x at offset p, in storage order
+	template <typename F>
+	void each(F& f)
+	{
+		for (size_t t = 0; t < tile.size(); t++)
+		{
+			if (!tile[t]) continue;
+			for (size_t i = 0; i < A; i++)
+			{
+				const size_t p = offset(t, i);
+				if (p < J * J) f(p, tile[t][i]);
+			}
+		}
+	}
+
+	// offsets of elements different from the default, in storage order
+	size_array find() const
+	{
+		size_t n = 0;
+		for (size_t t = 0; t < tile.size(); t++)
+			if (tile[t])
+				for (size_t i = 0; i < A; i++)
+					if (tile[t][i] != def) n++;
+
+		size_array pos(n);
+		n = 0;
+		for (size_t t = 0; t < tile.size(); t++)
+		{
+			if (!tile[t]) continue;
+			for (size_t i = 0; i < A; i++)
+				if (tile[t][i] != def)
+					pos[n++] = offset(t, i);
+		}
+		return pos;
+	}
+
+};
+
+//-----------------------------------------------------------------------------
+
+} // namespace ivl
+
+#endif // LIB_GRID_HPP
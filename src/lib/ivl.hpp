@@ -35,6 +35,8 @@
 #include "ivl_io.hpp"
 #include "ivl_files.hpp"
 #include "random.hpp"
+#include "grid.hpp"
+#include "thread.hpp"
 #include "args.hpp"
 
 #endif // LIB_IVL_HPP
@@ -35,26 +35,104 @@
 namespace ivl {
 
 //-----------------------------------------------------------------------------
+// splitmix64; each sampler owns one, so that sampling is reproducible
+// regardless of the order in which samplers are used across threads
 
-template <typename T, typename K = size_t>
+class random_engine
+{
+	typedef unsigned long long word;
+	word s;
+
+public:
+
+	random_engine(const word seed = 0) : s(seed) { }
+
+	word operator()()
+	{
+		word z = (s += 0x9E3779B97F4A7C15ULL);
+		z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+		z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+		return z ^ (z >> 31);
+	}
+
+	// uniform in [0, 1)
+	double uniform() { return ((*this)() >> 11) * (1. / 9007199254740992.); }
+};
+
+// combine a base seed with two keys, e.g. a dimension range
+inline size_t mix_seed(const size_t seed, const size_t a, const size_t b)
+{
+	random_engine e(seed);
+	random_engine f(e() ^ a);
+	return random_engine(f() ^ b)();
+}
+
+//-----------------------------------------------------------------------------
+
+// unkeyed (K = void) samples positions; keyed samples elements of a key array
+template <typename T, typename K = void>
 class sample_search_generator;
 
 //-----------------------------------------------------------------------------
 
+// samples positions in proportion to a distribution: with replacement in O(1)
+// by a Walker / Vose alias table, built on first use; and without replacement
+// in O(log D) by a binary indexed (Fenwick) tree of the remaining mass, from
+// which every chosen position is removed. Positions may also be marked as
+// chosen by the caller; each such position is met at most once more before
+// being removed, so there is no rejection loop. Chosen positions are never
+// expected to be reset.
+
 template <typename T>
-class sample_search_generator <T, size_t>
+class sample_search_generator <T, void>
 {
-	typedef sample_search_generator <T, size_t> generator;
+	typedef sample_search_generator <T, void> generator;
+
+	size_t D;                      // number of positions
+	array <T> weight;              // distribution
+	T total;                       // total mass
+	mutable random_engine engine;  // random source
 
-	size_t D;
-	array <T> cum;
-	T total;
+	// alias table, with replacement
+	mutable array <float> prob;    // probability of keeping each position
+	mutable array <size_t> alias;  // alternative position
+
+	// sum tree, without replacement
+	mutable array <T> tree;        // binary indexed tree on remaining mass
+	mutable T left;                // remaining mass
+	size_t top;                    // highest power of two <= D
 
 //-----------------------------------------------------------------------------
 
+	void build() const
+	{
+		prob.init(D);
+		alias.init(D);
+		array <double> p(D);
+		size_array small(D), large(D);
+		size_t ns = 0, nl = 0;
+		for (size_t i = 0; i < D; i++)
+		{
+			p[i] = total ? double(weight[i]) * D / total : 1.;
+			(p[i] < 1 ? small[ns++] : large[nl++]) = i;
+		}
+		while (ns && nl)
+		{
+			size_t s = small[--ns], l = large[--nl];
+			prob[s] = p[s];
+			alias[s] = l;
+			p[l] = (p[l] + p[s]) - 1;
+			(p[l] < 1 ? small[ns++] : large[nl++]) = l;
+		}
+		while (nl) prob[large[--nl]] = 1;
+		while (ns) prob[small[--ns]] = 1;  // round-off only
+	}
+
 	size_t sample() const
 	{
-		return first[ord](cum >= rand(T(0), total));
+		if (alias.empty()) build();
+		size_t i = std::min(size_t(engine.uniform() * D), D - 1);
+		return engine.uniform() < prob[i] ? i : alias[i];
 	}
 
 	template <typename S>
@@ -67,13 +145,60 @@ class sample_search_generator <T, size_t>
 
 //-----------------------------------------------------------------------------
 
+	void grow() const
+	{
+		tree = weight;
+		for (size_t k = 1; k <= D; k++)
+		{
+			size_t up = k + (k & -k);
+			if (up <= D) tree[up - 1] += tree[k - 1];
+		}
+		left = total;
+	}
+
+	// remaining mass at position x
+	T mass(const size_t x) const
+	{
+		const size_t i = x + 1, stop = i - (i & -i);
+		T m = tree[x];
+		for (size_t j = i - 1; j != stop; j -= j & -j)
+			m -= tree[j - 1];
+		return m;
+	}
+
+	void remove(const size_t x) const
+	{
+		T m = mass(x);
+		for (size_t k = x + 1; k <= D; k += k & -k)
+			tree[k - 1] -= m;
+		left -= m;
+	}
+
+	// first position where cumulative remaining mass exceeds r
+	size_t search(T r) const
+	{
+		size_t i = 0;
+		for (size_t step = top; step; step >>= 1)
+			if (i + step <= D && tree[i + step - 1] <= r)
+				r -= tree[(i += step) - 1];
+		return std::min(i, D - 1);
+	}
+
+//-----------------------------------------------------------------------------
+
+protected:
+
 	template <typename C>
 	size_t repeat(const C& chosen) const
 	{
-		size_t x;
-		do x = sample();
-		while (chosen[x]);
-		return x;
+		if (tree.empty()) grow();
+		for (;;)
+		{
+			if (!(left > T())) return sample();  // exhausted
+			size_t x = search(T(engine.uniform() * left));
+			if (!chosen[x]) return x;
+			remove(x);  // chosen by caller
+		}
 	}
 
 	template <typename S, typename C>
@@ -90,6 +215,7 @@ class sample_search_generator <T, size_t>
 	size_t replace(C& chosen) const
 	{
 		size_t x = repeat(chosen);
+		if (!chosen[x]) remove(x);
 		chosen[x] = true;
 		return x;
 	}
@@ -106,14 +232,15 @@ class sample_search_generator <T, size_t>
 
 public:
 
-	sample_search_generator() : D(0), total(0) { }
+	sample_search_generator() : D(0), total(0), left(0), top(0) { }
 
 	template <typename S>
-	sample_search_generator(const array <T, S>& distr) :
-		D(distr.length()), cum(cumsum(distr)), total(cum[D - 1])
+	sample_search_generator(const array <T, S>& distr, const size_t seed = 0) :
+		D(distr.length()), weight(distr), total(sum(distr)), engine(seed),
+		left(total), top(D ? size_t(1) << log2_(D) : 0)
 		{ }
 
-	void clear() { cum.init(); }
+	void clear() { weight.init(); prob.init(); alias.init(); tree.init(); }
 
 //-----------------------------------------------------------------------------
 
@@ -196,48 +323,84 @@ public:
 };
 
 //-----------------------------------------------------------------------------
+// chosen positions of a keyed generator, seen through the key
+
+template <typename C, typename K>
+struct sample_key_ref
+{
+	C& chosen;
+	const array <K>& key;
+
+	sample_key_ref(C& chosen, const array <K>& key) :
+		chosen(chosen), key(key) { }
+
+	typename C::elem_type operator[](const size_t x) const
+	{
+		return static_cast <const C&>(chosen)[key[x]];
+	}
+
+	typename C::elem_type& operator[](const size_t x) { return chosen[key[x]]; }
+};
+
+//-----------------------------------------------------------------------------
+
+// samples keys in proportion to a distribution over them, e.g. only the
+// non-empty positions of a sparse domain; chosen is indexed by key
 
 template <typename T, typename K>
-class sample_search_generator : public sample_search_generator <T, size_t>
+class sample_search_generator : public sample_search_generator <T, void>
 {
-	typedef sample_search_generator <T, size_t> base;
+	typedef sample_search_generator <T, void> base;
 
-	const array <K>& key;
+	array <K> key;
 
 public:
 
+	sample_search_generator() { }
+
 	template <typename S1, typename S2>
 	sample_search_generator(const array <K, S1>& key,
-									const array <T, S2>& distr) :
-		base(distr), key(key)
+									const array <T, S2>& distr, const size_t seed = 0) :
+		base(distr, seed), key(key)
 		{ }
 
-/*	array <K> operator()(const size_t N) const
+	void clear() { base::clear(); key.init(); }
+
+	K operator()() const { return key[base::operator()()]; }
+
+	template <typename C>
+	K operator()(C& chosen) const
 	{
-		return key[base::operator()(N)];
+		sample_key_ref <C, K> ref(chosen, key);
+		return key[base::replace(ref)];
 	}
 
-	template <typename S>
-	array <K> operator()(const size_t N, array <bool, S>& chosen) const
+	template <typename C>
+	array <K> operator()(const size_t N, C& chosen) const
 	{
-		return key[base::operator()(N, chosen)];
-	}*/
+		sample_key_ref <C, K> ref(chosen, key);
+		array <K> X(N);
+		for(size_t n = 0; n < N; n++)
+			X[n] = key[base::replace(ref)];
+		return X;
+	}
 };
 
 //-----------------------------------------------------------------------------
 
 template <typename T, typename S>
 sample_search_generator <T>
-sample_search(const array <T, S>& distr)
+sample_search(const array <T, S>& distr, const size_t seed = 0)
 {
-	return sample_search_generator <T> (distr);
+	return sample_search_generator <T> (distr, seed);
 }
 
 template <typename T, typename K, typename S1, typename S2>
 sample_search_generator <T, K>
-sample_search(const array <K, S1>& key, const array <T, S2>& distr)
+sample_search(const array <K, S1>& key, const array <T, S2>& distr,
+              const size_t seed = 0)
 {
-	return sample_search_generator <T, K> (key, distr);
+	return sample_search_generator <T, K> (key, distr, seed);
 }
 
 //-----------------------------------------------------------------------------
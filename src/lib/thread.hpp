@@ -0,0 +1,526 @@
+/* This file is part of drvq library <http://image.ntua.gr/iva/tools/drvq>.
+   A C++ library for dimensionality-recursive vector quantization.
+
+   Copyright (c) 2013, Yannis Avrithis <iavr@image.ntua.gr>.
+   All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without modification,
+   are permitted provided that the following conditions are met:
+
+   * Redistributions of source code must retain the above copyright notice, this
+     list of conditions and the following disclaimer.
+
+   * Redistributions in binary form must reproduce the above copyright notice, this
+     list of conditions and the following disclaimer in the documentation and/or
+     other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+   ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+   WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+   ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+   ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
+
+
+//-----------------------------------------------------------------------------
+
+#ifndef LIB_THREAD_HPP
+#define LIB_THREAD_HPP
+
+#include <algorithm>
+#include <deque>
+#include <map>
+#include <new>
+#include <vector>
+#include <pthread.h>
+
+//-----------------------------------------------------------------------------
+
+namespace ivl {
+
+//-----------------------------------------------------------------------------
+
+class thread_mutex
+{
+	pthread_mutex_t m;
+
+	thread_mutex(const thread_mutex&);
+	thread_mutex& operator=(const thread_mutex&);
+
+public:
+
+	thread_mutex(const bool recursive = false)
+	{
+		pthread_mutexattr_t a;
+		pthread_mutexattr_init(&a);
+		if (recursive) pthread_mutexattr_settype(&a, PTHREAD_MUTEX_RECURSIVE);
+		pthread_mutex_init(&m, &a);
+		pthread_mutexattr_destroy(&a);
+	}
+
+	~thread_mutex() { pthread_mutex_destroy(&m); }
+
+	void lock()   { pthread_mutex_lock(&m); }
+	void unlock() { pthread_mutex_unlock(&m); }
+
+	pthread_mutex_t* get() { return &m; }
+};
+
+//-----------------------------------------------------------------------------
+
+class thread_cond
+{
+	pthread_cond_t c;
+
+	thread_cond(const thread_cond&);
+	thread_cond& operator=(const thread_cond&);
+
+public:
+
+	thread_cond()  { pthread_cond_init(&c, 0); }
+	~thread_cond() { pthread_cond_destroy(&c); }
+
+	void wait(thread_mutex& m) { pthread_cond_wait(&c, m.get()); }
+	void signal()              { pthread_cond_signal(&c); }
+	void broadcast()           { pthread_cond_broadcast(&c); }
+};
+
+//-----------------------------------------------------------------------------
+
+class thread_lock
+{
+	thread_mutex& m;
+
+public:
+
+	thread_lock(thread_mutex& m) : m(m) { m.lock(); }
+	~thread_lock() { m.unlock(); }
+};
+
+//-----------------------------------------------------------------------------
+// free memory blocks kept by size for re-use, shared by threads; blocks of
+// equal size are recycled, already touched, instead of being freed and
+// allocated again. Free blocks are kept up to a total of cap bytes, beyond
+// which released blocks are freed; all are freed with the pool. Blocks are
+// raw memory, so only plain types may be stored in them (see pool_plain)
+
+class buffer_pool
+{
+	typedef std::vector <void*> blocks;
+	typedef std::map <size_t, blocks> block_map;
+
+	thread_mutex m;   // guards spare and held
+	block_map spare;  // free blocks per size in bytes
+	size_t held;      // bytes in free blocks
+	size_t cap;       // maximum bytes in free blocks
+
+	buffer_pool(const buffer_pool&);
+	buffer_pool& operator=(const buffer_pool&);
+
+public:
+
+	buffer_pool(const size_t cap = size_t(1) << 30) : held(0), cap(cap) { }
+	~buffer_pool() { clear(); }
+
+	// block of given bytes, recycled if any is free
+	void* acquire(const size_t bytes)
+	{
+		{
+			thread_lock l(m);
+			blocks& b = spare[bytes];
+			if (!b.empty())
+			{
+				void* x = b.back();
+				b.pop_back();
+				held -= bytes;
+				return x;
+			}
+		}
+		return ::operator new(bytes);
+	}
+
+	// append n blocks of given bytes to x, recycled under one lock if free
+	template <typename T>
+	void acquire(std::vector <T*>& x, const size_t n, const size_t bytes)
+	{
+		size_t k = 0;
+		{
+			thread_lock l(m);
+			blocks& b = spare[bytes];
+			for (; k < n && !b.empty(); k++, held -= bytes)
+			{
+				x.push_back(static_cast <T*>(b.back()));
+				b.pop_back();
+			}
+		}
+		for (; k < n; k++)
+			x.push_back(static_cast <T*>(::operator new(bytes)));
+	}
+
+	// return block of given bytes, for re-use if within cap
+	void release(void* x, const size_t bytes)
+	{
+		if (!x) return;
+		{
+			thread_lock l(m);
+			if (held + bytes <= cap)
+			{
+				spare[bytes].push_back(x);
+				held += bytes;
+				return;
+			}
+		}
+		::operator delete(x);
+	}
+
+	// return all non-null blocks x, each of given bytes, under one lock
+	template <typename T>
+	void release(const std::vector <T*>& x, const size_t bytes)
+	{
+		blocks drop;
+		{
+			thread_lock l(m);
+			blocks& b = spare[bytes];
+			for (size_t i = 0; i < x.size(); i++)
+			{
+				if (!x[i]) continue;
+				if (held + bytes <= cap) { b.push_back(x[i]); held += bytes; }
+				else drop.push_back(x[i]);
+			}
+		}
+		for (size_t i = 0; i < drop.size(); i++)
+			::operator delete(drop[i]);
+	}
+
+	// free all free blocks
+	void clear()
+	{
+		thread_lock l(m);
+		for (block_map::iterator i = spare.begin(); i != spare.end(); ++i)
+			for (size_t k = 0; k < i->second.size(); k++)
+				::operator delete(i->second[k]);
+		spare.clear();
+		held = 0;
+	}
+};
+
+//-----------------------------------------------------------------------------
+// elements in pooled blocks are assigned, never constructed or destroyed;
+// check is an invalid type unless T is plain, where the compiler can tell.
+// Standard trait builtins are preferred where available (clang deprecates
+// the older __has_trivial_* ones); elsewhere T is not checked, but must
+// still be trivially assignable and destructible
+
+#ifdef __has_builtin
+#if __has_builtin(__is_trivially_assignable) && \
+    __has_builtin(__is_trivially_destructible)
+#define THREAD_TRIVIAL_TRAITS
+#endif
+#endif
+
+template <typename T>
+struct pool_plain
+{
+#if defined(THREAD_TRIVIAL_TRAITS)
+	typedef char check[__is_trivially_assignable(T&, const T&) &&
+	                   __is_trivially_destructible(T) ? 1 : -1];
+#elif defined(__GNUC__) && !defined(__clang__)
+	typedef char check[__has_trivial_assign(T) &&
+	                   __has_trivial_destructor(T) ? 1 : -1];
+#else
+	typedef char check[1];
+#endif
+};
+
+//-----------------------------------------------------------------------------
+// n uninitialized elements of a plain type T in a block of a buffer_pool,
+// returned to the pool on destruction or re-initialization
+
+template <typename T>
+class pool_buffer
+{
+	typedef typename pool_plain <T>::check plain;
+
+	buffer_pool* pool;
+	T* x;
+	size_t n;
+
+	pool_buffer(const pool_buffer&);
+	pool_buffer& operator=(const pool_buffer&);
+
+public:
+
+	pool_buffer() : pool(0), x(0), n(0) { }
+	~pool_buffer() { reset(); }
+
+	// n elements from pool p; kept if already of size n
+	void init(buffer_pool& p, const size_t len)
+	{
+		if (x && pool == &p && n == len) return;
+		reset();
+		pool = &p;
+		n = len;
+		x = n ? static_cast <T*>(p.acquire(n * sizeof(T))) : 0;
+	}
+
+	// n elements from pool p, all equal to v
+	void assign(buffer_pool& p, const size_t len, const T& v)
+	{
+		init(p, len);
+		std::fill(x, x + n, v);
+	}
+
+	void reset()
+	{
+		if (x) pool->release(x, n * sizeof(T));
+		x = 0;
+		n = 0;
+	}
+
+	size_t size() const { return n; }
+
+	T& operator[](const size_t i) { return x[i]; }
+	const T& operator[](const size_t i) const { return x[i]; }
+};
+
+//-----------------------------------------------------------------------------
+// unit of work, spawned on a task_pool and joined by task_pool::sync()
+
+class task
+{
+	friend class task_pool;
+	volatile int finished;
+
+public:
+
+	task() : finished(0) { }
+	virtual ~task() { }
+
+	virtual void run() = 0;
+
+	bool done() const { __sync_synchronize(); return finished; }
+};
+
+//-----------------------------------------------------------------------------
+// chunk [begin, end) of a parallel loop over a range
+
+template <typename F>
+struct range_task : public task
+{
+	F* body;
+	size_t begin, end, chunk;
+
+	void run() { (*body)(begin, end, chunk); }
+};
+
+//-----------------------------------------------------------------------------
+// work-stealing pool of threads, including the calling thread; each thread
+// pops tasks from the back of its own deque and steals from the front of
+// others', so a pool of one thread runs all tasks in serial, depth-first order
+
+class task_pool
+{
+	struct worker
+	{
+		thread_mutex m;
+		std::deque <task*> q;
+	};
+
+	struct start
+	{
+		task_pool* pool;
+		size_t id;
+	};
+
+	const size_t P;      // number of threads
+	worker* w;           // task deque per thread
+	pthread_t* thread;   // thread handles; [0] is the calling thread
+	start* arg;          // thread start arguments
+	pthread_key_t key;   // thread id + 1, per thread
+
+	thread_mutex idle;   // guards pending, stop, waiting, task completion
+	thread_cond wake;    // signaled when a task is spawned
+	thread_cond change;  // broadcast to waiting sync() on spawn or completion
+	size_t pending;      // number of queued tasks
+	size_t waiting;      // number of threads blocked in sync()
+	bool stop;           // terminate threads?
+	buffer_pool scratch; // temporary memory shared by tasks
+
+//-----------------------------------------------------------------------------
+
+	size_t self() const
+	{
+		size_t id = reinterpret_cast <size_t>(pthread_getspecific(key));
+		return id ? id - 1 : 0;  // foreign threads share deque 0
+	}
+
+	task* pop(const size_t id, const bool back)
+	{
+		worker& v = w[id];
+		thread_lock l(v.m);
+		if (v.q.empty()) return 0;
+		task* t;
+		if (back) { t = v.q.back();  v.q.pop_back(); }
+		else      { t = v.q.front(); v.q.pop_front(); }
+		return t;
+	}
+
+	task* take(const size_t id)
+	{
+		task* t = pop(id, true);
+		for (size_t i = 1; !t && i < P; i++)
+			t = pop((id + i) % P, false);
+		if (t) { thread_lock l(idle); pending--; }
+		return t;
+	}
+
+	void exec(task* t)
+	{
+		t->run();
+		thread_lock l(idle);
+		__sync_synchronize();
+		t->finished = 1;
+		if (waiting) change.broadcast();
+	}
+
+//-----------------------------------------------------------------------------
+
+	void loop(const size_t id)
+	{
+		pthread_setspecific(key, reinterpret_cast <void*>(id + 1));
+		for (;;)
+		{
+			{
+				thread_lock l(idle);
+				while (!pending && !stop) wake.wait(idle);
+				if (stop) return;
+			}
+			if (task* t = take(id)) exec(t);
+		}
+	}
+
+	static void* main(void* a)
+	{
+		start* s = static_cast <start*>(a);
+		s->pool->loop(s->id);
+		return 0;
+	}
+
+	task_pool(const task_pool&);
+	task_pool& operator=(const task_pool&);
+
+//-----------------------------------------------------------------------------
+
+public:
+
+	task_pool(const size_t threads = 1) :
+		P(threads ? threads : 1), pending(0), waiting(0), stop(false)
+	{
+		w = new worker[P];
+		thread = new pthread_t[P];
+		arg = new start[P];
+		pthread_key_create(&key, 0);
+		pthread_setspecific(key, reinterpret_cast <void*>(1));
+		for (size_t p = 1; p < P; p++)
+		{
+			arg[p].pool = this;
+			arg[p].id = p;
+			pthread_create(&thread[p], 0, main, &arg[p]);
+		}
+	}
+
+	~task_pool()
+	{
+		{
+			thread_lock l(idle);
+			stop = true;
+			wake.broadcast();
+		}
+		for (size_t p = 1; p < P; p++)
+			pthread_join(thread[p], 0);
+		pthread_setspecific(key, 0);
+		pthread_key_delete(key);
+		delete[] arg;
+		delete[] thread;
+		delete[] w;
+	}
+
+//-----------------------------------------------------------------------------
+
+	size_t threads() const { return P; }
+
+	// temporary memory recycled across the tasks run on this pool
+	buffer_pool& buffers() { return scratch; }
+
+	// queue t on the calling thread's deque; t must outlive sync(t)
+	void spawn(task& t)
+	{
+		t.finished = 0;
+		size_t id = self();
+		{
+			thread_lock l(w[id].m);
+			w[id].q.push_back(&t);
+		}
+		thread_lock l(idle);
+		pending++;
+		wake.signal();
+		if (waiting) change.broadcast();
+	}
+
+	// wait for t, running queued or stolen tasks meanwhile; blocks while
+	// there is nothing to run
+	void sync(task& t)
+	{
+		size_t id = self();
+		while (!t.done())
+		{
+			if (task* u = take(id)) { exec(u); continue; }
+			thread_lock l(idle);
+			waiting++;
+			while (!t.finished && !pending) change.wait(idle);
+			waiting--;
+		}
+	}
+
+	void run(task& t) { spawn(t); sync(t); }
+
+//-----------------------------------------------------------------------------
+
+	// number of chunks of a loop over N elements, at least grain each
+	size_t chunks(const size_t N, const size_t grain) const
+	{
+		size_t n = N / (grain ? grain : 1);
+		return n < 1 ? 1 : n < 4 * P ? n : 4 * P;
+	}
+
+	// call body(begin, end, chunk) on consecutive chunks of [0, N)
+	template <typename F>
+	void parallel(const size_t N, const size_t grain, F& body)
+	{
+		const size_t n = chunks(N, grain);
+		range_task <F>* t = new range_task <F>[n];
+		for (size_t c = 0; c < n; c++)
+		{
+			t[c].body = &body;
+			t[c].begin = N * c / n;
+			t[c].end = N * (c + 1) / n;
+			t[c].chunk = c;
+		}
+		for (size_t c = n; c-- > 1; )
+			spawn(t[c]);
+		t[0].run();
+		for (size_t c = 1; c < n; c++)
+			sync(t[c]);
+		delete[] t;
+	}
+};
+
+//-----------------------------------------------------------------------------
+
+} // namespace ivl
+
+#endif // LIB_THREAD_HPP
@@ -109,7 +109,8 @@ void nn(const nn_options& opt = nn_options())
 	nn.verify(exact);
 	msg::nl(info);
 
-	// fast
+	// fast, compiled
+	book->compile();
 	msg::in_line(info, "quant (fast)...");
 	t.tic();
 	array <pos> q = book->quant(X);
@@ -0,0 +1,84 @@
+/* This file is part of drvq library <http://image.ntua.gr/iva/tools/drvq>.
+   A C++ library for dimensionality-recursive vector quantization.
+
+   Copyright (c) 2013, Yannis Avrithis <iavr@image.ntua.gr>.
+   All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without modification,
+   are permitted provided that the following conditions are met:
+
+   * Redistributions of source code must retain the above copyright notice, this
+     list of conditions and the following disclaimer.
+
+   * Redistributions in binary form must reproduce the above copyright notice, this
+     list of conditions and the following disclaimer in the documentation and/or
+     other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+   ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+   WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+   ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+   ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
+
+
+//-----------------------------------------------------------------------------
+
+#ifndef OPTIONS_BENCH_HPP
+#define OPTIONS_BENCH_HPP
+
+#include "train.hpp"
+
+namespace drvq {
+
+using namespace ivl;
+using namespace std;
+
+//-----------------------------------------------------------------------------
+
+struct bench_options : public train_options
+{
+	// parameters
+	size_t codebook;  // codebook id
+	size_t depth;     // node depth below codebook (0: top node)
+	size_t repeat;    // repetitions per measurement
+
+	bench_options() : codebook(0), depth(0), repeat(3) { }
+
+	virtual void display() const { }
+};
+
+//-----------------------------------------------------------------------------
+
+struct bench_args : public cmd_args <bench_options, bench_args>
+{
+	typedef cmd_args <bench_options, bench_args> base;
+
+	template <typename C>
+	void args(C cmd)
+	{
+		set(cmd, "book",       book,       "b", "codebook file name");
+		data_options::args(this, cmd, "input data");
+		descriptor_options::args(this, cmd);
+
+		set(cmd, "codebook",   codebook,   "c", "codebook id");
+		set(cmd, "depth",      depth,      "L", "node depth below codebook (0: top node)");
+		set(cmd, "repeat",     repeat,     "R", "repetitions per measurement");
+		set(cmd, "range",      range,      "r", "maximum range of edges in propagation");
+		set(cmd, "layout",     layout(),   "y", "grid layout [0: tiled, 1: Morton tiles, 2: Morton tiles, relabeled children]");
+		set(cmd, "bucket",     bucket,     "B", "bucket size in hash queue");
+		set(cmd, "seed",       seed,       "s", "random seed");
+	}
+
+	bench_args(int argc, char* argv[]) : base(argc, argv) { done(); }
+};
+
+//-----------------------------------------------------------------------------
+
+}  // namespace drvq
+
+#endif  // OPTIONS_BENCH_HPP
@@ -51,11 +51,15 @@ struct label_options : public descriptor_options, public offline_options
 	bool distortion;           // use distortion (distances to labels)?
 	int_<method_type> method;  // labeling method
 	double range;              // range of edge weights to explore in method 1 (> 0)
+	size_t threads;            // number of labeling threads
+	bool tiled;                // store large lookup tables of method 0 in tiles?
+	bool expand;               // method 2 by norm expansion of distances?
 
 	label_options() :
 		book  ("../out/codebook.bin"),
 		label ("../out/labels.bin"),
-		distortion(true), method(exact), range(.45)
+		distortion(true), method(exact), range(.45), threads(1), tiled(false),
+		expand(false)
 		{ }
 
 	bool brief() const { return method == fast; }
@@ -79,6 +83,9 @@ struct label_args : public cmd_args <label_options, label_args>
 		set(cmd, "distortion", distortion, "ds", "use distortion (distances to labels)?");
 		set(cmd, "method",     method(),   "m",  "labeling method [0: fast, 1: approx, 2: exact]");
 		set(cmd, "range",      range,      "r",  "range of edge weights to explore in method 1 (> 0)");
+		set(cmd, "threads",    threads,    "j",  "number of labeling threads, each loading and labeling whole files");
+		set(cmd, "tiled",      tiled,      "t",  "store large lookup tables of method 0 in tiles of 4x4 children labels");
+		set(cmd, "expand",     expand,     "x",  "method 2 by norm expansion of distances; faster, labels may differ on near ties");
 	}
 
 	label_args(int argc, char* argv[]) : base(argc, argv) { done(); }
@@ -41,6 +41,12 @@ using namespace std;
 
 class train_options : public descriptor_options, public offline_options
 {
+public:
+
+	enum queue_type { heap, hash, radix };
+	enum layout_type { tiled, morton, relabel };
+	enum seeding_type { population, plus };
+
 protected:
 
 	size_t cap_id;   // capacity id
@@ -110,19 +116,38 @@ public:
 
 	// paths / files
 	string book;     // output codebook file name
+	string exchange; // directory shared by distributed processes
+	string run;      // id of distributed run, common to all its processes
+	string checkpoint;  // directory of trained subtrees, if not empty
+	string init;     // codebook file to start from, if not empty
 
 	// parameters
 	size_t books;    // number of codebooks
 	size_array cap;  // capacity per level; should be > 1
 	double theta;    // termination parameter
+	double improve;  // minimum relative improvement of distortion per iteration
+	int_<seeding_type> seeding;  // initial centroid sampling
 	double range;    // maximum range of edges in propagation
-	bool hash;       // use hash queue?
+	double shift;    // centroid shift tolerance in incremental assignment
+	size_t multigrid;  // coarse grid levels of multigrid schedule
+	size_t cache;    // memory cap of each child distance table, in MB
+	int_<queue_type> queue;  // propagation queue type
+	int_<layout_type> layout;  // grid storage layout
 	size_t bucket;   // bucket size in hash queue
+	size_t threads;  // number of training threads
+	size_t seed;     // random seed
+	bool stream;     // stream data from files, one pass per level?
+	size_t shards;   // number of distributed processes
+	size_t shard;    // index of this process; 0 is the coordinator
+	bool resume;     // load trained subtrees from checkpoint directory?
+	size_t timeout;  // maximum wait for a file of another process, in seconds
 
 	train_options() :
-		book("../out/codebook.bin"),
-		books(4), cap_id(2), theta(5), range(.35),
-		hash(false), bucket(20)
+		book("../out/codebook.bin"), exchange("../out/exchange"), run(""), checkpoint(""),
+		init(""),
+		books(4), cap_id(2), theta(5), improve(0), seeding(population), range(.35), shift(0), multigrid(0), cache(256),
+		queue(heap), layout(tiled), bucket(20), threads(1), seed(0),
+		stream(false), shards(1), shard(0), resume(false), timeout(86400)
 	{
 		set_capacity();
 	}
@@ -146,9 +171,26 @@ struct train_args : public cmd_args <train_options, train_args>
 		set(cmd, "books",      books,      "b", "number of codebooks");
 		set(cmd, "capacity",   cap_id,     "c", "capacity per level [SIFT: 0..7; SURF: 0..3]");
 		set(cmd, "theta",      theta,      "t", "termination parameter");
+		set(cmd, "improve",    improve,    "g", "terminate when relative improvement of distortion per iteration drops below this [0: off, use theta]");
+		set(cmd, "seeding",    seeding(),  "a", "initial centroids [0: in proportion to population, 1: k-means++ on squared distances]");
 		set(cmd, "range",      range,      "r", "maximum range of edges in propagation");
-		set(cmd, "hash",       hash,       "H", "use hash queue?");
+		set(cmd, "shift",      shift,      "S", "centroid shift tolerance in incremental assignment, relative to mean distance [0: off]");
+		set(cmd, "multigrid",  multigrid,  "G", "coarse grid levels iterated before the full grid, each merging children labels in pairs [0: off]");
+		set(cmd, "cache",      cache,      "m", "memory cap of each child distance table, in MB");
+		set(cmd, "queue",      queue(),    "Q", "propagation queue [0: binary heap, 1: hash, 2: radix heap]");
+		set(cmd, "layout",     layout(),   "y", "grid layout [0: tiled, 1: Morton tiles, 2: Morton tiles, relabeled children]");
 		set(cmd, "bucket",     bucket,     "B", "bucket size in hash queue");
+		set(cmd, "threads",    threads,    "j", "number of training threads");
+		set(cmd, "seed",       seed,       "s", "random seed");
+		set(cmd, "stream",     stream,     "x", "stream training data from files, one pass per tree level");
+		set(cmd, "shards",     shards,     "N", "number of distributed processes, each streaming a shard of the files");
+		set(cmd, "shard",      shard,      "i", "index of this process [0: coordinator, saving codebooks]");
+		set(cmd, "exchange",   exchange,   "X", "directory shared by distributed processes");
+		set(cmd, "run",        run,        "U", "id of distributed run, distinct per run and common to its processes");
+		set(cmd, "timeout",    timeout,    "T", "maximum wait for a file of another process, in seconds [0: no limit]");
+		set(cmd, "checkpoint", checkpoint, "K", "directory to save each trained subtree in [empty: none]");
+		set(cmd, "resume",     resume,     "R", "load subtrees already saved in checkpoint directory instead of training");
+		set(cmd, "init",       init,       "I", "codebook file to start training from [empty: random samples]");
 		set_capacity();
 	}
 
@@ -0,0 +1,226 @@
+/* This file is part of drvq library <http://image.ntua.gr/iva/tools/drvq>.
+   A C++ library for dimensionality-recursive vector quantization.
+
+   Copyright (c) 2013, Yannis Avrithis <iavr@image.ntua.gr>.
+   All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without modification,
+   are permitted provided that the following conditions are met:
+
+   * Redistributions of source code must retain the above copyright notice, this
+     list of conditions and the following disclaimer.
+
+   * Redistributions in binary form must reproduce the above copyright notice, this
+     list of conditions and the following disclaimer in the documentation and/or
+     other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+   ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+   WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+   ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+   ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
+
+
+//-----------------------------------------------------------------------------
+
+#ifndef SEARCH_EXACT_HPP
+#define SEARCH_EXACT_HPP
+
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+namespace drvq {
+
+using namespace ivl;
+using namespace std;
+
+//-----------------------------------------------------------------------------
+
+// Exact encoder on the flattened centroids of a set of codebooks. Squared
+// distances are expanded as |x|^2 - 2 x.c + |c|^2, with centroid norms
+// computed once; dot products are computed GEMM-style on tiles of points,
+// R points at a time against panels of W centroids stored dimension by
+// dimension, so that the inner loop runs over W contiguous values and the
+// R x W accumulators stay in registers. The minimum per point is tracked
+// while panels are visited, so no distance matrix is ever stored.
+
+template <typename T>
+class exact_encoder
+{
+	typedef typename tree <T>::lab lab;    // label type
+	typedef typename tree <T>::pos pos;    // position type
+	typedef typename tree <T>::data data;  // data type
+
+	enum { W = 8, R = 4, S = 64 };  // centroids per panel, points per block, points per tile
+
+	size_t C;                     // number of codebooks
+	size_t J;                     // centroids per codebook
+	size_t P;                     // panels per codebook
+	array <size_array> dim;       // dimension ranges per codebook
+	std::vector <size_t> start;   // offset of panels per codebook
+	std::vector <T> panel;        // W centroids per panel, dimension by dimension
+	std::vector <T> norm;         // squared norms, P * W per codebook
+
+//-----------------------------------------------------------------------------
+
+	// minimum distances best and labels arg of n <= S points of tile x,
+	// with squared norms xn, to the centroids of codebook c
+	void block(const size_t c, const T* x, const T* xn, const size_t n,
+	           T* best, lab* arg) const
+	{
+		const size_t D = dim[c].length();
+		for (size_t i = 0; i < n; i++)
+			best[i] = std::numeric_limits <T>::max();
+
+		for (size_t p = 0; p < P; p++)
+		{
+			const T* cp = &panel[start[c] + p * D * W];
+			const T* cn = &norm[(c * P + p) * W];
+			for (size_t i0 = 0; i0 < n; i0 += R)
+			{
+				// R x W dot products
+				T acc[R][W];
+				for (size_t r = 0; r < R; r++)
+					for (size_t w = 0; w < W; w++)
+						acc[r][w] = T();
+				const T* xi = x + i0 * D;
+				for (size_t d = 0; d < D; d++)
+				{
+					const T* cd = cp + d * W;
+					for (size_t r = 0; r < R; r++)
+					{
+						const T v = xi[r * D + d];
+						for (size_t w = 0; w < W; w++)
+							acc[r][w] += v * cd[w];
+					}
+				}
+
+				// running minimum, first in label order on ties
+				const size_t rows = std::min(size_t(R), n - i0);
+				for (size_t r = 0; r < rows; r++)
+					for (size_t w = 0; w < W; w++)
+					{
+						const T dist = xn[i0 + r] - 2 * acc[r][w] + cn[w];
+						if (dist < best[i0 + r])
+						{
+							best[i0 + r] = dist;
+							arg[i0 + r] = lab(p * W + w);
+						}
+					}
+			}
+		}
+	}
+
+//-----------------------------------------------------------------------------
+
+	// labels l and, if d is not null, distances d of points X, accumulated
+	// over codebooks with label stride J per codebook
+	void encode(const data& X, array <pos>& l, array <T>* d) const
+	{
+		const size_t N = X[0].length();
+		std::vector <T> x, xn(S), best(S);
+		std::vector <lab> arg(S);
+		for (size_t c = 0, stride = 1; c < C; c++, stride *= J)
+		{
+			const size_array& at = dim[c];
+			const size_t D = at.length();
+			x.assign(S * D, T());
+			for (size_t n0 = 0; n0 < N; n0 += S)
+			{
+				// tile of points, point by point, zero-padded
+				const size_t n = std::min(size_t(S), N - n0);
+				std::fill(x.begin() + n * D, x.end(), T());
+				for (size_t i = 0; i < n; i++)
+				{
+					T s = T();
+					for (size_t k = 0; k < D; k++)
+					{
+						const T v = X[at[k]][n0 + i];
+						x[i * D + k] = v;
+						s += v * v;
+					}
+					xn[i] = s;
+				}
+
+				block(c, &x[0], &xn[0], n, &best[0], &arg[0]);
+				for (size_t i = 0; i < n; i++)
+				{
+					l[n0 + i] += stride * arg[i];
+					if (d) (*d)[n0 + i] += std::max(best[i], T());
+				}
+			}
+		}
+	}
+
+//-----------------------------------------------------------------------------
+
+public:
+
+	exact_encoder() : C(0), J(0), P(0) { }
+
+	bool empty() const { return !C; }
+
+	// flattened centroids cen of C codebooks of J centroids each, on
+	// dimension ranges dim
+	void init(const size_t books, const size_t side,
+	          const array <size_array>& d, const data& cen)
+	{
+		C = books;
+		J = side;
+		P = (J + W - 1) / W;
+		dim = d;
+		start.assign(C + 1, 0);
+		for (size_t c = 0; c < C; c++)
+			start[c + 1] = start[c] + P * dim[c].length() * W;
+		panel.assign(start[C], T());
+		norm.assign(C * P * W, std::numeric_limits <T>::max());  // padding never wins
+
+		for (size_t c = 0; c < C; c++)
+		{
+			const size_array& at = dim[c];
+			const size_t D = at.length();
+			for (size_t j = 0; j < J; j++)
+			{
+				const size_t p = j / W, w = j % W;
+				T s = T();
+				for (size_t k = 0; k < D; k++)
+				{
+					const T v = cen[at[k]][j];
+					panel[start[c] + (p * D + k) * W + w] = v;
+					s += v * v;
+				}
+				norm[c * P * W + j] = s;
+			}
+		}
+	}
+
+	array <pos> operator()(const data& X) const
+	{
+		if (X.empty()) return array <pos>();
+		array <pos> l(X[0].length(), size_t(0));
+		encode(X, l, 0);
+		return l;
+	}
+
+	ret <array <pos>, array <T> >
+	operator()(const data& X, types::t_true) const
+	{
+		if (X.empty()) return array <pos>();
+		array <pos> l(X[0].length(), size_t(0));
+		array <T> d(X[0].length(), T());
+		encode(X, l, &d);
+		return (_, l, d);
+	}
+};
+
+//-----------------------------------------------------------------------------
+
+}  // namespace drvq
+
+#endif  // SEARCH_EXACT_HPP
@@ -0,0 +1,417 @@
+/* This file is part of drvq library <http://image.ntua.gr/iva/tools/drvq>.
+   A C++ library for dimensionality-recursive vector quantization.
+
+   Copyright (c) 2013, Yannis Avrithis <iavr@image.ntua.gr>.
+   All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without modification,
+   are permitted provided that the following conditions are met:
+
+   * Redistributions of source code must retain the above copyright notice, this
+     list of conditions and the following disclaimer.
+
+   * Redistributions in binary form must reproduce the above copyright notice, this
+     list of conditions and the following disclaimer in the documentation and/or
+     other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+   ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+   WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+   ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+   ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
+
+
+//-----------------------------------------------------------------------------
+
+#ifndef SEARCH_FAST_HPP
+#define SEARCH_FAST_HPP
+
+#include <algorithm>
+#include <vector>
+
+namespace drvq {
+
+using namespace ivl;
+using namespace std;
+
+//-----------------------------------------------------------------------------
+
+// Fast (lookup) encoder compiled from the trees of a set of codebooks. All
+// subtrees are flattened to units in bottom-up level order, leaves first,
+// referring to each other by index; source tables are stored in this order
+// in one arena, followed by children codes. Points are encoded in batches,
+// one unit at a time over the whole batch, so that each level is a tight
+// loop of gathers, with no virtual calls or allocation per level. Table
+// entries are prefetched a fixed distance ahead, running over into the
+// entries of the next unit, so that lookups of many points are in flight
+// at once. Large tables may be stored in tiles of Q x Q children labels,
+// so that neighboring children labels share cache lines. Tables start on
+// cache lines: each is padded to a multiple of A labels, and contents are
+// placed at an offset shift into the arena where a cache line starts.
+
+template <typename T>
+class fast_encoder
+{
+	typedef typename tree <T>::lab lab;    // label type
+	typedef typename tree <T>::pos pos;    // position type
+	typedef typename tree <T>::data data;  // data type
+
+	enum { S = 128, D = 16 };  // points per batch, prefetch distance
+	enum { Q = 4, M = 1 << 18 };  // tile side, minimum table size to tile
+	enum { A = 64 / sizeof(lab) };  // labels per cache line
+
+	// subtree; a leaf if it has no children
+	struct unit
+	{
+		size_t child0, child1;  // children units; none() for leaves
+		size_t level;           // height above leaves
+		size_t dim;             // data dimension, for leaves
+		size_t side;            // children capacity, or number of bins for leaves
+		size_t tiles;           // tiles per row of source table if tiled, else 0
+		size_t size;            // number of centroids
+		size_t table;           // offset of source table in arena
+		size_t codes;           // offset of children codes in arena, or of centroids for leaves
+		T base, bin;            // data interval minimum and bin size, for leaves
+	};
+
+	static size_t none() { return size_t(-1); }
+
+	size_t C;                  // number of codebooks
+	size_t J;                  // labels per codebook
+	std::vector <unit> units;  // all subtrees, in bottom-up level order
+	std::vector <size_t> top;  // unit per codebook
+	std::vector <lab> arena;   // source tables, then children codes
+	size_t shift;              // offset of contents in arena, on a cache line
+	std::vector <T> cen;       // leaf centroids
+
+//-----------------------------------------------------------------------------
+
+	// append units of subtree t on data dimensions at, children first, along
+	// with t itself to from; return its unit
+	size_t collect(const tree <T>* t, const size_array& at,
+	               std::vector <const tree <T>*>& from)
+	{
+		unit u;
+		u.size = t->size();
+		u.table = u.codes = 0;
+		const node <T>* n = dynamic_cast <const node <T>*>(t);
+		if (n)
+		{
+			u.child0 = collect(n->children(0), at[n->dims(0)], from);
+			u.child1 = collect(n->children(1), at[n->dims(1)], from);
+			u.level = 1 + std::max(units[u.child0].level, units[u.child1].level);
+			u.dim = 0;
+			u.side = n->side();
+			u.tiles = 0;
+			u.base = u.bin = T();
+		}
+		else
+		{
+			const leaf <T>* f = static_cast <const leaf <T>*>(t);
+			u.child0 = u.child1 = none();
+			u.level = 0;
+			u.dim = at[0];
+			u.side = f->sources().length();
+			u.tiles = 0;
+			u.base = f->origin();
+			u.bin = f->width();
+		}
+		units.push_back(u);
+		from.push_back(t);
+		return units.size() - 1;
+	}
+
+//-----------------------------------------------------------------------------
+
+	static void prefetch(const lab* p)
+	{
+#ifdef __GNUC__
+		__builtin_prefetch(p);
+#endif
+	}
+
+	// offsets off into the table of unit u of n points of X from n0, given
+	// labels q of children units; bins out of the data interval are clamped
+	void offsets(const size_t u, const data& X, const size_t n0, const size_t n,
+	             const lab* q, size_t* off) const
+	{
+		const unit& a = units[u];
+		if (a.child0 == none())
+		{
+			const array <T>& x = X[a.dim];
+			const T last = T(a.side - 1);
+			for (size_t i = 0; i < n; i++)
+			{
+				const T b = (x[n0 + i] - a.base) / a.bin;
+				off[i] = b < T() ? 0 : b < last ? size_t(b) : a.side - 1;
+			}
+			return;
+		}
+
+		const lab *q0 = q + a.child0 * S, *q1 = q + a.child1 * S;
+		if (!a.tiles)
+			for (size_t i = 0; i < n; i++)
+				off[i] = q0[i] + a.side * q1[i];
+		else
+			for (size_t i = 0; i < n; i++)
+				off[i] = ((q1[i] / Q) * a.tiles + q0[i] / Q) * (Q * Q) +
+				         (q1[i] % Q) * Q + q0[i] % Q;
+	}
+
+	// out[i] = s[off[i]] for n offsets, prefetching D offsets ahead, over
+	// into m offsets next of table t
+	static void gather(const lab* s, const size_t* off, lab* out, const size_t n,
+	                   const lab* t, const size_t* next, const size_t m)
+	{
+		for (size_t i = 0; i < n; i++)
+		{
+			if (i + D < n)          prefetch(s + off[i + D]);
+			else if (i + D - n < m) prefetch(t + next[i + D - n]);
+			out[i] = s[off[i]];
+		}
+	}
+
+//-----------------------------------------------------------------------------
+
+	// move contents, followed by A - 1 spare labels, to the first cache line
+	// of the arena; again after copying, since the buffer moves
+	void align()
+	{
+		if (arena.empty()) return;
+		const size_t n = arena.size() - (A - 1);
+		const size_t p = reinterpret_cast <size_t>(&arena[0]);
+		const size_t s = (64 - p % 64) % 64 / sizeof(lab);
+		if (s < shift)
+			std::copy(arena.begin() + shift, arena.begin() + shift + n,
+			          arena.begin() + s);
+		else if (s > shift)
+			std::copy_backward(arena.begin() + shift, arena.begin() + shift + n,
+			                   arena.begin() + s + n);
+		shift = s;
+	}
+
+//-----------------------------------------------------------------------------
+
+	// labels l and, if d is not null, distances d of points X, accumulated
+	// over codebooks with label stride J per codebook
+	void encode(const data& X, array <pos>& l, array <T>* d) const
+	{
+		const size_t N = X[0].length(), U = units.size();
+		const lab* a = &arena[shift];  // contents of arena
+		std::vector <lab> q(U * S);  // label per unit per point of batch
+		std::vector <size_t> cur(S), next(S);  // offsets of this and next unit
+		for (size_t n0 = 0; n0 < N; n0 += S)
+		{
+			const size_t n = std::min(size_t(S), N - n0);
+
+			// labels of all units, level by level; offsets of the next unit
+			// are known in advance unless this unit is one of its children
+			offsets(0, X, n0, n, &q[0], &cur[0]);
+			for (size_t u = 0; u < U; u++)
+			{
+				const bool last = u + 1 == U;
+				const bool ahead = !last &&
+					units[u + 1].child0 != u && units[u + 1].child1 != u;
+				if (ahead) offsets(u + 1, X, n0, n, &q[0], &next[0]);
+				gather(a + units[u].table, &cur[0], &q[u * S], n,
+				       last ? 0 : a + units[u + 1].table, &next[0],
+				       ahead ? n : 0);
+				if (last) break;
+				if (!ahead) offsets(u + 1, X, n0, n, &q[0], &next[0]);
+				cur.swap(next);
+			}
+
+			for (size_t c = 0, stride = 1; c < C; c++, stride *= J)
+			{
+				const lab* qc = &q[top[c] * S];
+				for (size_t i = 0; i < n; i++)
+					l[n0 + i] += stride * qc[i];
+			}
+			if (!d) continue;
+
+			// codes of top labels, top-down in place, and squared distances
+			// to centroids at leaves
+			for (size_t u = U; u-- > 0; )
+			{
+				const unit& t = units[u];
+				const lab* qu = &q[u * S];
+				if (t.child0 == none())
+				{
+					const array <T>& x = X[t.dim];
+					const T* c = &cen[t.codes];
+					for (size_t i = 0; i < n; i++)
+					{
+						const T e = x[n0 + i] - c[qu[i]];
+						(*d)[n0 + i] += e * e;
+					}
+				}
+				else
+				{
+					const lab *c0 = a + t.codes, *c1 = c0 + t.size;
+					lab *q0 = &q[t.child0 * S], *q1 = &q[t.child1 * S];
+					for (size_t i = 0; i < n; i++)
+					{
+						q0[i] = c0[qu[i]];
+						q1[i] = c1[qu[i]];
+					}
+				}
+			}
+		}
+	}
+
+//-----------------------------------------------------------------------------
+
+public:
+
+	fast_encoder() : C(0), J(0), shift(0) { }
+
+	fast_encoder(const fast_encoder& e) :
+		C(e.C), J(e.J), units(e.units), top(e.top), arena(e.arena),
+		shift(e.shift), cen(e.cen)
+		{ align(); }
+
+	fast_encoder& operator=(const fast_encoder& e)
+	{
+		C = e.C;
+		J = e.J;
+		units = e.units;
+		top = e.top;
+		arena = e.arena;
+		shift = e.shift;
+		cen = e.cen;
+		align();
+		return *this;
+	}
+
+	bool empty() const { return !C; }
+
+	// trees book of C codebooks of J labels each, on dimension ranges dim;
+	// source tables of at least M labels are tiled if tiled is true
+	void init(const size_t books, const size_t side,
+	          const array <size_array>& dim, const array <tree <T>*>& book,
+	          const bool tiled = false)
+	{
+		C = books;
+		J = side;
+		units.clear();
+		top.assign(C, 0);
+		std::vector <const tree <T>*> from;
+		for (size_t c = 0; c < C; c++)
+			top[c] = collect(book[c], dim[c], from);
+
+		// bottom-up level order, stable within levels
+		const size_t U = units.size();
+		size_t L = 0;
+		for (size_t u = 0; u < U; u++)
+			L = std::max(L, units[u].level);
+		std::vector <size_t> order, at(U);
+		for (size_t h = 0; h <= L; h++)
+			for (size_t u = 0; u < U; u++)
+				if (units[u].level == h)
+				{
+					at[u] = order.size();
+					order.push_back(u);
+				}
+
+		std::vector <unit> sorted(U);
+		for (size_t i = 0; i < U; i++)
+		{
+			unit& u = sorted[i] = units[order[i]];
+			if (u.child0 == none()) continue;
+			u.child0 = at[u.child0];
+			u.child1 = at[u.child1];
+		}
+		units.swap(sorted);
+		for (size_t c = 0; c < C; c++)
+			top[c] = at[top[c]];
+
+		// source tables, each padded to cache lines, then children codes and
+		// leaf centroids
+		arena.clear();
+		shift = 0;
+		cen.clear();
+		for (size_t i = 0; i < U; i++)
+		{
+			unit& u = units[i];
+			arena.resize((arena.size() + A - 1) / A * A, lab(0));
+			u.table = arena.size();
+			if (u.child0 == none())
+			{
+				const array <lab>& s =
+					static_cast <const leaf <T>*>(from[order[i]])->sources();
+				for (size_t p = 0; p < u.side; p++)
+					arena.push_back(s[p]);
+			}
+			else
+			{
+				const array_2d <lab>& s =
+					static_cast <const node <T>*>(from[order[i]])->sources();
+				const size_t J2 = u.side * u.side;
+				if (!tiled || J2 < M)
+					for (size_t p = 0; p < J2; p++)
+						arena.push_back(s[p]);
+				else
+				{
+					// tile by tile, row by row within tiles, zero-padded
+					u.tiles = (u.side + Q - 1) / Q;
+					arena.resize(u.table + u.tiles * u.tiles * Q * Q, lab(0));
+					for (size_t j1 = 0; j1 < u.side; j1++)
+						for (size_t j0 = 0; j0 < u.side; j0++)
+							arena[u.table + ((j1 / Q) * u.tiles + j0 / Q) * (Q * Q) +
+							      (j1 % Q) * Q + j0 % Q] = s[j0 + u.side * j1];
+				}
+			}
+		}
+		for (size_t i = 0; i < U; i++)
+		{
+			unit& u = units[i];
+			if (u.child0 == none())
+			{
+				const array <T>& c =
+					static_cast <const leaf <T>*>(from[order[i]])->centers();
+				u.codes = cen.size();
+				for (size_t k = 0; k < u.size; k++)
+					cen.push_back(c[k]);
+			}
+			else
+			{
+				const node <T>* n = static_cast <const node <T>*>(from[order[i]]);
+				u.codes = arena.size();
+				for (size_t j = 0; j < 2; j++)
+					for (size_t k = 0; k < u.size; k++)
+						arena.push_back(n->codes(j)[k]);
+			}
+		}
+		arena.resize(arena.size() + A - 1, lab(0));
+		align();
+	}
+
+	array <pos> operator()(const data& X) const
+	{
+		if (X.empty()) return array <pos>();
+		array <pos> l(X[0].length(), size_t(0));
+		encode(X, l, 0);
+		return l;
+	}
+
+	ret <array <pos>, array <T> >
+	operator()(const data& X, types::t_true) const
+	{
+		if (X.empty()) return array <pos>();
+		array <pos> l(X[0].length(), size_t(0));
+		array <T> d(X[0].length(), T());
+		encode(X, l, &d);
+		return (_, l, d);
+	}
+};
+
+//-----------------------------------------------------------------------------
+
+}  // namespace drvq
+
+#endif  // SEARCH_FAST_HPP
@@ -98,6 +98,13 @@ public:
 	virtual const array <array <T> >&
 	weights() const { return weight; }
 
+	const array <T>& centers() const { return cen; }
+	const array <lab>& sources() const { return source; }
+	T origin() const { return base; }
+	T width() const { return bin; }
+
+	virtual void unsource() { source.init(); }
+
 //-----------------------------------------------------------------------------
 
 	virtual array <lab> quant(const data& X, const size_array& at) const
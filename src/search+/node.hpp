@@ -73,7 +73,8 @@ public:
 
 //-----------------------------------------------------------------------------
 
-	node(std::istream& s) :
+	// children are read too, unless a derived class reads them
+	node(std::istream& s, const bool deep = true) :
 		K(ivl::read <size_t>(s)),
 		J(ivl::read <size_t>(s)),
 		dim0(read_array <size_t>()(s)),
@@ -82,8 +83,10 @@ public:
 		code1(read_array <lab>()(s)),
 		source(read_array_2d <array <lab> >()(s)),
 		edge(read_array <array <lab> >()(s)),
-		weight(read_array <array <T> >()(s))
+		weight(read_array <array <T> >()(s)),
+		child0(0), child1(0)
 	{
+		if (!deep) return;
 		read(child0, s);
 		read(child1, s);
 	}
@@ -98,6 +101,19 @@ public:
 	virtual const array <array <T> >&
 	weights() const { return weight; }
 
+	tree <T>* children(size_t i) const { return i ? child1 : child0; }
+	const size_array& dims(size_t i) const { return i ? dim1 : dim0; }
+	const array <lab>& codes(size_t i) const { return i ? code1 : code0; }
+	const array_2d <lab>& sources() const { return source; }
+	size_t side() const { return J; }
+
+	virtual void unsource()
+	{
+		source.init(idx(0, 0));  // TODO: init()
+		child0 -> unsource();
+		child1 -> unsource();
+	}
+
 //-----------------------------------------------------------------------------
 
 	virtual array <lab> quant(const data& X, const size_array& at) const
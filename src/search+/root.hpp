@@ -61,6 +61,8 @@ protected:
 	const size_t J;                // children capacity
 	const array <size_array> dim;  // child dimension ranges
 	array <tree <T>*> child;       // children
+	exact_encoder <T> engine;      // exact encoder on flattened centroids, if expanded
+	fast_encoder <T> fast;         // fast encoder on flattened trees, if compiled
 
 //-----------------------------------------------------------------------------
 
@@ -80,6 +82,28 @@ protected:
 		return (_, nn, d);
 	}
 
+//-----------------------------------------------------------------------------
+
+	// points per tile of recursive exact search, so that distances of a
+	// tile to the centroids of one child fit in cache
+	size_t tile() const
+	{
+		return std::max(size_t(1), (size_t(1) << 18) / (J * sizeof(T)));
+	}
+
+	// points [n0, n1) of X
+	static data slice(const data& X, const size_t n0, const size_t n1)
+	{
+		data Y(X.length());
+		for (size_t d = 0; d < X.length(); d++)
+		{
+			Y[d].init(n1 - n0);
+			for (size_t n = n0; n < n1; n++)
+				Y[d][n - n0] = X[d][n];
+		}
+		return Y;
+	}
+
 //-----------------------------------------------------------------------------
 
 	void read(tree <T>*& t, std::istream& s)
@@ -108,6 +132,23 @@ public:
 			read(child[c], s);
 	}
 
+	// build fast encoder on current codebooks, storing source tables of at
+	// least 2^18 labels in tiles if tiled is true. With strip, source tables
+	// of the trees are dropped, since the encoder holds its own copy; only
+	// quant() without range is then supported
+	void compile(const bool tiled = false, const bool strip = false)
+	{
+		fast.init(C, J, dim, child, tiled);
+		if (strip)
+			for (size_t c = 0; c < C; c++)
+				child[c] -> unsource();
+	}
+
+	// build exact encoder by norm expansion on current codebooks; faster,
+	// but distances are rounded differently than by the recursive path, so
+	// labels of nearly equidistant points may differ. Used only on request
+	void expand() { engine.init(C, J, dim, flat()); }
+
 //-----------------------------------------------------------------------------
 
 	size_t dims()           const { return max(dim[C - 1]) + 1; }
@@ -120,13 +161,18 @@ public:
 		return child[c]->weights();
 	}
 
+	tree <T>* book(size_t c) const { return child[c]; }
+	const size_array& dims(size_t c) const { return dim[c]; }
+
 //-----------------------------------------------------------------------------
 
 	array <pos> quant(const data& X) const { return quant(no(), X); }
 
+	// by fast encoder if compiled, otherwise recursively on subtrees
 	array <pos> quant(no, const data& X) const
 	{
 		if (X.empty()) return array <pos>();
+		if (!fast.empty()) return fast(X);
 		array <pos> l(X[0].length(), size_t(0));
 		for (size_t c = 0, stride = 1; c < C; c++, stride *= J)
 			l += stride * child[c] -> quant(X, dim[c]);
@@ -139,6 +185,7 @@ public:
 	quant(yes, const data& X) const
 	{
 		if (X.empty()) return array <pos>();
+		if (!fast.empty()) return fast(X, yes());
 		size_t N = X[0].length();
 		array <lab> q;
 		array <pos> l(N, size_t(0));
@@ -149,7 +196,7 @@ public:
 			l += stride * q;
 			d += child[c] -> dist2(X, dim[c], q);
 		}
-		return (_, l, q);
+		return (_, l, d);
 	}
 
 //-----------------------------------------------------------------------------
@@ -191,40 +238,57 @@ public:
 
 	array <pos> exact(const data& X) const { return exact(no(), X); }
 
+	// by exact encoder if expanded, otherwise recursively on subtrees,
+	// over tiles of points
 	array <pos>
 	exact(no, const data& X) const
 	{
 		if (X.empty()) return array <pos>();
-		array <array_2d <T> > dist(C);
-		for (size_t c = 0; c < C; c++)
-			dist[c] = child[c] -> dist2(X, dim[c]);
+		if (!engine.empty()) return engine(X);
 		size_t N = X[0].length();
-		array <pos> l(N, size_t(0));  // TODO: l = arg_min[1](dist[0]) + J * arg_min[1](dist[1]) + ...;
-		for (size_t n = 0; n < N; n++)
+		array <pos> l(N, size_t(0));
+		for (size_t n0 = 0, S = tile(); n0 < N; n0 += S)
+		{
+			const size_t n1 = min(N, n0 + S);
+			const data Xt = slice(X, n0, n1);
 			for (size_t c = 0, stride = 1; c < C; c++, stride *= J)
-				l[n] += stride * arg_min(dist[c].as_rows()[n]);
+			{
+				const array_2d <T> dist = child[c] -> dist2(Xt, dim[c]);
+				for (size_t n = n0; n < n1; n++)
+					l[n] += stride * arg_min(dist.as_rows()[n - n0]);
+			}
+		}
 		return l;
 	}
 
 //-----------------------------------------------------------------------------
 
+	// distances summed over children, as for quant()
 	ret <array <pos>, array <T> >
 	exact(yes, const data& X) const
 	{
 		if (X.empty()) return array <pos>();
-		array <array_2d <T> > dist(C);
-		for (size_t c = 0; c < C; c++)
-			dist[c] = child[c] -> dist2(X, dim[c]);
+		if (!engine.empty()) return engine(X, yes());
 		size_t N = X[0].length();
 		size_t q;
-		array <pos> l(N, size_t(0));  // TODO: l = arg_min[1](dist[0]) + J * arg_min[1](dist[1]) + ...;
+		T m;
+		array <pos> l(N, size_t(0));
 		array <T> d(N, T());
-		for (size_t n = 0; n < N; n++)
+		for (size_t n0 = 0, S = tile(); n0 < N; n0 += S)
+		{
+			const size_t n1 = min(N, n0 + S);
+			const data Xt = slice(X, n0, n1);
 			for (size_t c = 0, stride = 1; c < C; c++, stride *= J)
 			{
-				(_, d[n], q) = min++(dist[c].as_rows()[n]);  // TODO: dist[c].as_rows()[n][...] not compiling
-				l[n] += stride * q;
+				const array_2d <T> dist = child[c] -> dist2(Xt, dim[c]);
+				for (size_t n = n0; n < n1; n++)
+				{
+					(_, m, q) = min++(dist.as_rows()[n - n0]);  // TODO: dist.as_rows()[n][...] not compiling
+					l[n] += stride * q;
+					d[n] += m;
+				}
 			}
+		}
 		return (_, l, d);
 	}
 
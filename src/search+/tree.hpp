@@ -46,6 +46,8 @@ struct tree
 	// TODO: use indirect (eventually slice) types
 	typedef array <array <T> > data;  // data type
 
+	virtual ~tree() { }
+
 	virtual size_t size() const = 0;
 	virtual const array <array <lab> >& edges() const = 0;
 	virtual const array <array <T> >& weights() const = 0;
@@ -63,6 +65,10 @@ struct tree
 												const array <array <lab> >&) const = 0;
 
 	virtual void flat(data& C, const size_array& at, const array <lab>& c) = 0;
+
+	// drop source tables of the subtree, once compiled into an encoder;
+	// quant() is no longer supported on it
+	virtual void unsource() = 0;
 };
 
 //-----------------------------------------------------------------------------
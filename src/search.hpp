@@ -34,6 +34,8 @@
 #include "search+/tree.hpp"
 #include "search+/leaf.hpp"
 #include "search+/node.hpp"
+#include "search+/exact.hpp"
+#include "search+/fast.hpp"
 #include "search+/root.hpp"
 
 #endif  // SEARCH_HPP
@@ -0,0 +1,210 @@
+/* This file is part of drvq library <http://image.ntua.gr/iva/tools/drvq>.
+   A C++ library for dimensionality-recursive vector quantization.
+
+   Copyright (c) 2013, Yannis Avrithis <iavr@image.ntua.gr>.
+   All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without modification,
+   are permitted provided that the following conditions are met:
+
+   * Redistributions of source code must retain the above copyright notice, this
+     list of conditions and the following disclaimer.
+
+   * Redistributions in binary form must reproduce the above copyright notice, this
+     list of conditions and the following disclaimer in the documentation and/or
+     other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+   ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+   WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+   ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+   ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
+
+
+//-----------------------------------------------------------------------------
+
+#ifndef TRAIN_BIN_HPP
+#define TRAIN_BIN_HPP
+
+namespace drvq {
+
+using namespace ivl;
+using namespace std;
+
+//-----------------------------------------------------------------------------
+
+// all that propagation reads or writes per grid bin, packed in one record so
+// that visiting a bin touches a single cache line; 16 bytes for float
+template <typename T, typename lab, typename count>
+struct bin_record
+{
+	typedef T dist_type;         // distance type
+	typedef unsigned int index;  // position in queue, or state
+
+	T distance;   // distance from nearest centroid
+	lab source;   // nearest centroid label
+	index order;  // position in queue, or alive / burnt
+	count pop;    // population; non-zero on target domain
+
+	static index alive() { return index(-1); }
+	static index burnt() { return index(-2); }
+
+	bin_record() : distance(), source(0), order(alive()), pop(0) { }
+};
+
+//-----------------------------------------------------------------------------
+
+// queue positions on a grid of records, as a reference array for queues
+template <typename R>
+class bin_order
+{
+	tile_grid <R>* bins;
+
+public:
+
+	bin_order() : bins(0) { }
+	bin_order(tile_grid <R>& b) : bins(&b) { }
+
+	typename R::index& operator[](const size_t p) { return (*bins)[p].order; }
+};
+
+// distances on a grid of records, as a key array for queues
+template <typename R, typename T>
+class bin_distance
+{
+	const tile_grid <R>* bins;
+
+public:
+
+	bin_distance() : bins(0) { }
+	bin_distance(const tile_grid <R>& b) : bins(&b) { }
+
+	T operator[](const size_t p) const { return (*bins)[p].distance; }
+};
+
+//-----------------------------------------------------------------------------
+
+// set state of all allocated records, optionally clearing distance
+template <typename R>
+struct bin_reset
+{
+	typename R::index state;
+	bool clear;
+
+	bin_reset(typename R::index s, bool c) : state(s), clear(c) { }
+
+	void operator()(size_t, R& b)
+	{
+		b.order = state;
+		if (clear) b.distance = typename R::dist_type();
+	}
+};
+
+// count records on target domain; only those not burnt, unless all
+template <typename R>
+struct bin_count
+{
+	size_t n;
+	bool all;
+
+	bin_count(bool a = true) : n(0), all(a) { }
+
+	void operator()(size_t, R& b)
+	{
+		if (b.pop && (all || b.order != R::burnt())) n++;
+	}
+};
+
+// copy labels of allocated records to a dense grid; on the target domain,
+// count labels changed and sum distortion (population times distance)
+template <typename R, typename S>
+struct bin_source
+{
+	S& source;
+	size_t changed;
+	double distortion;
+
+	bin_source(S& s) : source(s), changed(0), distortion(0) { }
+
+	void operator()(size_t p, R& b)
+	{
+		if (b.pop)
+		{
+			if (source[p] != b.source) changed++;
+			distortion += double(b.pop) * b.distance;
+		}
+		source[p] = b.source;
+	}
+};
+
+// offsets of allocated records whose label is flagged, in storage order
+template <typename R>
+struct bin_select
+{
+	const array <char>& flag;
+	std::vector <size_t> pos;
+
+	bin_select(const array <char>& f) : flag(f) { }
+
+	void operator()(size_t p, R& b)
+	{
+		if (flag[b.source]) pos.push_back(p);
+	}
+};
+
+//-----------------------------------------------------------------------------
+
+// breadth-first order of labels on their graph, over edges within range;
+// gives the position of each label, so that neighbors are placed nearby
+template <typename lab, typename T>
+size_array bfs_order(const array <array <lab> >& edge,
+                     const array <array <T> >& weight, const double range)
+{
+	const size_t J = edge.length();
+	size_array at(J, J);   // position per label; J if not yet placed
+	size_array visit(J);   // labels in visiting order
+	for (size_t s = 0, head = 0, tail = 0; s < J; s++)
+	{
+		if (at[s] < J) continue;
+		at[s] = tail;
+		visit[tail++] = s;
+		while (head < tail)
+		{
+			const size_t u = visit[head++];
+			for (size_t i = 1; i < edge[u].length(); i++)  // skip self (loop)
+			{
+				const size_t v = edge[u][i];
+				if (weight[u][i] >= range || at[v] < J) continue;
+				at[v] = tail;
+				visit[tail++] = v;
+			}
+		}
+	}
+	return at;
+}
+
+// set storage layout of a grid of records on an empty grid: Morton order
+// within tiles, and children labels relabeled in breadth-first order on
+// their edges, so that bins propagated together are stored together
+template <typename R, typename lab, typename T>
+void bin_layout(tile_grid <R>& bins, const int layout, const double range,
+                const array <array <lab> >& edge0, const array <array <T> >& weight0,
+                const array <array <lab> >& edge1, const array <array <T> >& weight1)
+{
+	if (layout == train_options::tiled) return;
+	bins.morton();
+	if (layout == train_options::relabel)
+		bins.relabel(bfs_order(edge0, weight0, range),
+		             bfs_order(edge1, weight1, range));
+}
+
+//-----------------------------------------------------------------------------
+
+}  // namespace drvq
+
+#endif  // TRAIN_BIN_HPP
@@ -0,0 +1,357 @@
+/* This file is part of drvq library <http://image.ntua.gr/iva/tools/drvq>.
+   A C++ library for dimensionality-recursive vector quantization.
+
+   Copyright (c) 2013, Yannis Avrithis <iavr@image.ntua.gr>.
+   All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without modification,
+   are permitted provided that the following conditions are met:
+
+   * Redistributions of source code must retain the above copyright notice, this
+     list of conditions and the following disclaimer.
+
+   * Redistributions in binary form must reproduce the above copyright notice, this
+     list of conditions and the following disclaimer in the documentation and/or
+     other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+   ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+   WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+   ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+   ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
+
+
+//-----------------------------------------------------------------------------
+
+#ifndef TRAIN_COARSE_HPP
+#define TRAIN_COARSE_HPP
+
+#include <algorithm>
+#include "prop.hpp"
+
+namespace drvq {
+
+using namespace ivl;
+using namespace std;
+
+//-----------------------------------------------------------------------------
+
+// matching on a graph of labels: each label, in order, is grouped with its
+// nearest unmatched neighbor over an edge within range, if any. Gives the
+// group per label, numbered in order, and the number of groups n
+template <typename lab, typename T>
+size_array match_labels(const array <array <lab> >& edge,
+                        const array <array <T> >& weight,
+                        const double range, size_t& n)
+{
+	const size_t J = edge.length();
+	size_array group(J, J);  // J if not yet matched
+	n = 0;
+	for (size_t u = 0; u < J; u++)
+	{
+		if (group[u] < J) continue;
+		size_t near = J;
+		for (size_t i = 1; i < edge[u].length(); i++)  // skip self (loop)
+		{
+			const size_t v = edge[u][i];
+			if (group[v] < J || weight[u][i] >= range) continue;
+			if (near == J || weight[u][i] < weight[u][near]) near = i;
+		}
+		group[u] = n;
+		if (near < J) group[edge[u][near]] = n;
+		n++;
+	}
+	return group;
+}
+
+// edges between n groups of labels, one for each pair of neighboring
+// groups, weighted by the minimum weight of the label edges it merges;
+// loops first, as for labels
+template <typename lab, typename T>
+void merge_edges(const array <array <lab> >& edge,
+                 const array <array <T> >& weight,
+                 const size_array& group, const size_t n,
+                 array <array <lab> >& g_edge, array <array <T> >& g_weight)
+{
+	const size_t J = edge.length();
+
+	// labels per group, by counting sort
+	size_array first(n + 1, size_t(0)), member(J);
+	for (size_t u = 0; u < J; u++)
+		first[group[u] + 1]++;
+	for (size_t g = 0; g < n; g++)
+		first[g + 1] += first[g];
+	size_array fill = first;
+	for (size_t u = 0; u < J; u++)
+		member[fill[group[u]]++] = u;
+
+	g_edge.init(n);
+	g_weight.init(n);
+	size_array at(n, n);  // position of each group in current edge list
+	for (size_t g = 0; g < n; g++)
+	{
+		array <lab>& e = g_edge[g];
+		array <T>& w = g_weight[g];
+		e.push_back(g);
+		w.push_back(0);
+		for (size_t m = first[g]; m < first[g + 1]; m++)
+		{
+			const size_t u = member[m];
+			for (size_t i = 1; i < edge[u].length(); i++)  // skip self (loop)
+			{
+				const size_t h = group[edge[u][i]];
+				if (h == g) continue;
+				if (at[h] == n)
+				{
+					at[h] = e.length();
+					e.push_back(h);
+					w.push_back(weight[u][i]);
+				}
+				else w[at[h]] = std::min(w[at[h]], weight[u][i]);
+			}
+		}
+		for (size_t i = 1; i < e.length(); i++)
+			at[e[i]] = n;
+	}
+}
+
+//-----------------------------------------------------------------------------
+
+// coarse grid of a node, for the early iterations of a multigrid schedule:
+// labels of each child are merged by matching over their edges, level times,
+// and the grid is propagated on merged labels. A coarse bin is as far from a
+// centroid as the nearest of the bins it merges, and its population is
+// their total. Labels are expanded back to the domain bins of the full grid
+template <typename T, typename lab, typename pos, typename count>
+class coarse_grid
+{
+	typedef bin_record <T, lab, count> record;
+	typedef sample_search_generator <count, pos> generator;
+
+	size_t J;                          // merged labels per child
+	size_array group0, group1;         // merged label per child label
+	array <array <lab> > edge0, edge1;    // edges between merged labels
+	array <array <T> > weight0, weight1;  // their weights
+	array_2d <T> dist0, dist1;         // centroid distances to merged labels
+	array <lab> code0, code1;          // centroids quantized to merged labels
+	array_2d <lab> source;             // nearest centroid label on coarse grid
+	tile_grid <record> bins;           // per-bin records on coarse grid
+	array <array <lab> > edge;         // edges between centroids; unused
+	array <array <T> > weight;         // edge weights; unused
+	generator gen;                     // random sample generator
+	tile_grid <char> chosen;           // is each bin chosen as a sample?
+	size_array dom;                    // domain bins on full grid
+	array <pos> at;                    // coarse bin per domain bin
+	size_t n;                          // number of coarse domain bins
+	size_t moves;                      // domain bins changing label @ last assignment
+	double loss;                       // distortion @ last assignment
+
+//-----------------------------------------------------------------------------
+
+	// merge labels of one child, level times
+	size_t merge(const array <array <lab> >& e, const array <array <T> >& w,
+	             const size_t level, const double range,
+	             size_array& group, array <array <lab> >& g_edge,
+	             array <array <T> >& g_weight)
+	{
+		size_t m = e.length();
+		group.init(m);
+		for (size_t j = 0; j < m; j++)
+			group[j] = j;
+		g_edge = e;
+		g_weight = w;
+		for (size_t l = 0; l < level; l++)
+		{
+			size_array g = match_labels(g_edge, g_weight, range, m);
+			array <array <lab> > ge;
+			array <array <T> > gw;
+			merge_edges(g_edge, g_weight, g, m, ge, gw);
+			g_edge = ge;
+			g_weight = gw;
+			for (size_t j = 0; j < group.length(); j++)
+				group[j] = g[group[j]];
+		}
+		return m;
+	}
+
+	// loops only for labels m..J-1, padding a child of m labels
+	void pad(const size_t m, array <array <lab> >& e, array <array <T> >& w) const
+	{
+		if (m == J) return;
+		array <array <lab> > pe(J);
+		array <array <T> > pw(J);
+		for (size_t g = 0; g < J; g++)
+		{
+			pe[g] = g < m ? e[g] : array <lab>(1, lab(g));
+			pw[g] = g < m ? w[g] : array <T>(1, T());
+		}
+		e = pe;
+		w = pw;
+	}
+
+	// minimum of distances d per merged label; columns beyond the labels of
+	// a child are never reached, and are as far as the farthest label
+	void gather(const array_2d <T>& d, const size_array& group,
+	            array_2d <T>& out) const
+	{
+		const size_t K = d.rows(), F = d.columns();
+		out.init(idx(K, J));
+		for (size_t k = 0; k < K; k++)
+		{
+			const T far = max(d.as_rows()[k]);
+			for (size_t g = 0; g < J; g++)
+				out(k, g) = far;
+			for (size_t j = 0; j < F; j++)
+				out(k, group[j]) = std::min(out(k, group[j]), d(k, j));
+		}
+	}
+
+	// child label of group g nearest to centroid k, by distances d
+	static lab nearest(const array_2d <T>& d, const size_array& group,
+	                   const size_t k, const size_t g)
+	{
+		size_t near = d.columns();
+		for (size_t j = 0; j < d.columns(); j++)
+			if (group[j] == g && (near == d.columns() || d(k, j) < d(k, near)))
+				near = j;
+		return lab(near);
+	}
+
+//-----------------------------------------------------------------------------
+
+public:
+
+	coarse_grid() : J(0), n(0), moves(0), loss(0) { }
+
+	bool empty() const { return !J; }
+	size_t size() const { return n; }
+	size_t side() const { return J; }
+
+	// build at given level on children edges, over domain bins dom of a
+	// full grid of side F with population d_pop, on tiles of buffers; clear
+	// if level is 0
+	void init(const size_t level, const size_t F,
+	          const array <array <lab> >& e0, const array <array <T> >& w0,
+	          const array <array <lab> >& e1, const array <array <T> >& w1,
+	          const size_array& d, const array <count>& d_pop,
+	          const double range, const size_t seed, buffer_pool& buffers)
+	{
+		clear();
+		if (!level) return;
+		dom = d;
+
+		// merged labels; the grid is square, padded to the larger child
+		size_t m0 = merge(e0, w0, level, range, group0, edge0, weight0),
+		       m1 = merge(e1, w1, level, range, group1, edge1, weight1);
+		J = std::max(m0, m1);
+		pad(m0, edge0, weight0);
+		pad(m1, edge1, weight1);
+
+		// coarse domain and population
+		tile_grid <count> c_pop;
+		c_pop.recycle(&buffers);
+		c_pop.init(idx(J, J), count(0));
+		at.init(dom.length());
+		for (size_t i = 0; i < dom.length(); i++)
+		{
+			at[i] = group0[dom[i] % F] + J * group1[dom[i] / F];
+			c_pop[at[i]] += d_pop[i];
+		}
+		size_array c_dom = c_pop.find();
+		array <count> c_d_pop(c_dom.length());
+		for (size_t i = 0; i < c_dom.length(); i++)
+			c_d_pop[i] = c_pop[c_dom[i]];
+		n = c_dom.length();
+
+		bins.recycle(&buffers);
+		bins.init(idx(J, J));
+		for (size_t i = 0; i < n; i++)
+			bins[c_dom[i]].pop = c_d_pop[i];
+		source.init(idx(J, J));
+		gen = sample_search(c_dom, c_d_pop, seed);
+		chosen.recycle(&buffers);
+		chosen.init(idx(J, J), false);
+	}
+
+	void clear()
+	{
+		J = n = 0;
+		group0.init();
+		group1.init();
+		edge0.init();
+		edge1.init();
+		weight0.init();
+		weight1.init();
+		dist0.init(idx(0, 0));
+		dist1.init(idx(0, 0));
+		source.init(idx(0, 0));
+		bins.init(0);
+		gen.clear();
+		chosen.init(0);
+		dom.init();
+		at.init();
+	}
+
+//-----------------------------------------------------------------------------
+
+	// propagate centroids of full-grid distances d0, d1 and codes c0, c1 on
+	// the coarse grid, and expand labels to the domain bins of full source.
+	// Centroids re-sampled on the coarse grid are written back to c0, c1,
+	// each as the child label of its merged label nearest to the centroid
+	template <int Q>
+	void operator()(const array_2d <T>& d0, const array_2d <T>& d1,
+	                array <lab>& c0, array <lab>& c1,
+	                array_2d <lab>& full, queue_kind <Q>,
+	                const train_options& opt, bool detail)
+	{
+		const size_t K = c0.length();
+		gather(d0, group0, dist0);
+		gather(d1, group1, dist1);
+		code0.init(K);
+		code1.init(K);
+		edge.init(K);
+		weight.init(K);
+		for (size_t k = 0; k < K; k++)
+		{
+			code0[k] = group0[c0[k]];
+			code1[k] = group1[c1[k]];
+			chosen(code0[k], code1[k]) = true;
+		}
+
+		prop <T, lab, pos, count, Q>
+			P(source, bins, edge, weight,
+		     code0, code1, dist0, dist1,
+		     edge0, edge1, weight0, weight1,
+		     opt);
+
+		P(gen, chosen, types::t_false(), detail);
+		moves = P.changed();
+		loss = P.distortion();
+
+		for (size_t k = 0; k < K; k++)
+			if (code0[k] != group0[c0[k]] || code1[k] != group1[c1[k]])
+			{
+				c0[k] = nearest(d0, group0, k, code0[k]);
+				c1[k] = nearest(d1, group1, k, code1[k]);
+			}
+
+		for (size_t i = 0; i < dom.length(); i++)
+			full[dom[i]] = source[at[i]];
+	}
+
+	// coarse domain bins changing label, and total distortion, at last
+	// propagation
+	size_t changed() const { return moves; }
+	double distortion() const { return loss; }
+};
+
+//-----------------------------------------------------------------------------
+
+}  // namespace drvq
+
+#endif  // TRAIN_COARSE_HPP
@@ -65,39 +65,72 @@ class train_leaf : public leaf <T>, public train_tree <T>
 	array <lab> label;        // centroid label per data point
 
 	// temporary
+	array <count> b_pop;      // population per bin
+	array <T> b_mass;         // mass per bin
 	generator gen;            // random sample generator
 	array <bool> chosen;      // is each bin chosen as a sample?
+	double distortion;        // distortion @ last assignment
 
 //-----------------------------------------------------------------------------
 
 	void train
 	(
-		const array <T>& X,       // data points
-		const train_options& opt  // training options
+		const array <T>& X,        // data points
+		const train_options& opt,  // training options
+		const size_t seed          // random seed
 	)
 	{
 		// trivial cases
 		if (X.empty() || K < 2) return;
 
+		// quantize data points into bins, in one pass; bins are kept in
+		// label until trained
+		const size_t B = K * R;                // number of bins
+		b_mass.init(B, T());                   // mass per bin
+		b_pop.init(B, count(0));               // population per bin
+		label.init(X.length());                // nearest bin per data point
+		for (size_t n = 0; n < X.length(); n++)
+		{
+			const lab c = lab((X[n] - base) / bin);
+			label[n] = c;
+			b_pop[c]++;
+			b_mass[c] += X[n];
+		}
+
+		train(opt, seed);
+
+		// store data labels
+		for (size_t n = 0; n < X.length(); n++)
+			label[n] = source[label[n]];
+	}
+
+	// train on populations and masses per bin
+	void train
+	(
+		const train_options& opt,  // training options
+		const size_t seed          // random seed
+	)
+	{
+		// trivial cases
+		if (K < 2) return;
+
 		// initialize
 		const size_t B = K * R;         // number of bins
 		size_array zero, nz;            // empty and non-empty bins
 		const array <T> val =
 			base + (0, _, B - 1) * bin;  // values at all bins
-
-		// quantize data points into bins
-		array <T> b_mass(B, T());                  // mass per bin
-		array <count> pop(K), b_pop(B, count(0));  // population per centroid / bin
-		array <lab> code = (X - base) / bin;       // nearest bin per data point
-		b_pop[code]++;
-		b_mass[code] += X;
+		array <count> pop(K);           // population per centroid
 
 		// initialize centroids & assignments
-		gen = sample_search(b_pop);               // generator on bin distribution
+		gen = sample_search(b_pop, seed);         // generator on bin distribution
 		chosen.init(B, false);                    // is each bin chosen as a sample?
-		sample(val);
+		if (!warm(val))
+		{
+			if (opt.seeding == train_options::plus) sample_plus(val, seed);
+			else sample(val);
+		}
 		assign();
- 		array <lab> prev = source;                // label @ previous iteration
+		double last_dist = distortion;            // distortion @ previous iteration
 
 		for (size_t it = 0; ; it++)
 		{
@@ -114,17 +147,11 @@ class train_leaf : public leaf <T>, public train_tree <T>
 			// re-sample empty centroids
 			sample(val, zero);
 
-			// update assignments
-			assign();
-
-			// OPTIONAL: total distortion (sum of square residuals)
-			// T distortion = sum(b_pop * (val - cen[source]) ->* 2);
-
-			// terminate?
-			double ratio = opt.theta * _[it * .01] ->* 2;
-			if (find(source != prev).length() < B * ratio)
+			// update assignments, and terminate?
+			const size_t changed = assign();
+			if (train_tree <T>::converged(opt, it, changed, B,
+			                              distortion, last_dist))
 				break;
-			prev = source;
 		}
 
 		// re-sample empty centroids
@@ -137,21 +164,77 @@ class train_leaf : public leaf <T>, public train_tree <T>
 		// generate centroid edges
 		generate_edges();
 
-		// store data labels
-		label = source[code];
-
 		// clear temporaries
+		b_pop.init();
+		b_mass.init();
 		gen.clear();
 		chosen.init();
 	}
 
 //-----------------------------------------------------------------------------
 
+	// start from centroids of trained leaf, if any and of equal capacity;
+	// clamped to the values of bins
+	bool warm(const array <T>& val)
+	{
+		const leaf <T>* w = dynamic_cast <const leaf <T>*>(this->init);
+		if (!w || w->size() != K) return false;
+		const array <T>& c = w->centers();
+		for (size_t k = 0; k < K; k++)
+			cen[k] = std::min(std::max(c[k], val[0]), val[val.length() - 1]);
+		return true;
+	}
+
 	void sample(const array <T>& val)
 	{
 		cen = sort(val[gen(K, chosen)]);  // samples with replacement
 	}
 
+	// k-means++ seeding: each centroid drawn among bins in proportion to
+	// population times squared distance to its nearest centroid so far
+	void sample_plus(const array <T>& val, const size_t seed)
+	{
+		const size_t B = val.length();
+		array <double> d2(B, 1.);  // squared distance to nearest centroid
+		double total = 0;          // sum of population times d2
+		for (size_t b = 0; b < B; b++)
+			total += b_pop[b];
+		random_engine engine(mix_seed(seed, K, B));
+
+		for (size_t k = 0; k < K; k++)
+		{
+			// draw in proportion to population times d2; from the population
+			// if all populated bins are taken
+			size_t c;
+			if (total > 0)
+			{
+				double r = engine.uniform() * total;
+				size_t last = 0;        // last bin of positive weight
+				for (c = 0; c < B; c++)
+				{
+					const double p = b_pop[c] * d2[c];
+					if (p <= 0) continue;
+					last = c;
+					if ((r -= p) < 0) break;
+				}
+				if (c == B) c = last;   // r left over by rounding
+				chosen[c] = true;
+			}
+			else c = gen(chosen);
+			cen[k] = val[c];
+
+			// nearest centroid distances
+			total = 0;
+			for (size_t b = 0; b < B; b++)
+			{
+				const double d = (val[b] - val[c]) * (val[b] - val[c]);
+				if (!k || d < d2[b]) d2[b] = d;
+				total += b_pop[b] * d2[b];
+			}
+		}
+		cen = sort(cen);
+	}
+
 	void sample(const array <T>& val, const size_array& which)
 	{
 		cen[which] = val[gen(which.length(), chosen)];
@@ -160,15 +243,24 @@ class train_leaf : public leaf <T>, public train_tree <T>
 
 //-----------------------------------------------------------------------------
 
-	void assign()
+	// label bins by the midpoints of sorted centroids, in one pass that also
+	// sums distortion; returns the number of bins changing label
+	size_t assign()
 	{
 		const size_t B = K * R;
 		size_array mid =
 			((cen[0, _, K - 2] + cen[1, _, K - 1]) / 2 - base) / bin;
-		source[0, _, mid[0] - 1] = 0;
-		source[mid[K - 2], _, B - 1] = K - 1;
-		for (size_t k = 1; k < K - 1; k++)
-			source[mid[k - 1], _, mid[k] - 1] = k;
+		size_t changed = 0;
+		distortion = 0;
+		for (size_t b = 0, k = 0; b < B; b++)
+		{
+			while (k < K - 1 && b >= mid[k]) k++;
+			if (source[b] != k) changed++;
+			source[b] = k;
+			const T r = base + b * bin - cen[k];
+			distortion += double(b_pop[b]) * r * r;
+		}
+		return changed;
 	}
 
 //-----------------------------------------------------------------------------
@@ -194,8 +286,10 @@ public:
 
 	train_leaf
 	(
-		const array <T>& X,       // data points
-		const train_options& opt  // training options
+		const array <T>& X,         // data points
+		const train_options& opt,   // training options
+		const size_t seed,          // random seed
+		const tree <T>* init = 0    // trained leaf to start from, if any
 	) :
 	leaf <T>
 	(
@@ -205,7 +299,25 @@ public:
 		opt.cap[0]       // K
 	)
 	{
-		train(X, opt);
+		this->init = init;
+		train(X, opt, seed);
+	}
+
+	// trained, as written by write(), without type
+	train_leaf(std::istream& s) : leaf <T>(s) { }
+
+	// untrained, on data interval [min, max], to accumulate data in blocks
+	// by add() and train by fit()
+	train_leaf
+	(
+		const T min,               // data interval minimum
+		const T max,               // data interval maximum
+		const train_options& opt   // training options
+	) :
+	leaf <T>(min, max, opt.cap[0] * R, opt.cap[0])
+	{
+		b_pop.init(K * R, count(0));
+		b_mass.init(K * R, T());
 	}
 
 //-----------------------------------------------------------------------------
@@ -239,7 +351,53 @@ public:
 	virtual const array <array <T> >&
 	weights() const { return weight; }
 
-	virtual void release() { label.init(); }
+	virtual void release() { label.init(); this->uncache(); }
+	virtual void unlabel() { label.init(); }
+	virtual void unsource() { source.init(); }
+
+	virtual void restore(const book&, const data& X, const size_array& at)
+	{
+		if (!X.empty()) label = quant(X, at);
+	}
+
+	virtual void add(const data& X, const size_array& at)
+	{
+		// TODO: X[at[0]] -> X[0]
+		const array <T>& x = X[at[0]];
+		for (size_t n = 0; n < x.length(); n++)
+		{
+			const lab c = lab((x[n] - base) / bin);
+			b_pop[c]++;
+			b_mass[c] += x[n];
+		}
+	}
+
+	virtual void fit(const size_array& at, const train_options& opt,
+						  task_pool&)
+	{
+		train(opt, train_tree <T>::seed(opt, at));
+	}
+
+	virtual void write_stats(std::ostream& s) const
+	{
+		write_array(b_pop, s);
+		write_array(b_mass, s);
+	}
+
+	virtual void read_stats(std::istream& s)
+	{
+		b_pop += read_array <count>()(s);
+		b_mass += read_array <T>()(s);
+	}
+
+	virtual void write_source(std::ostream& s) const { write_array(source, s); }
+
+	virtual void read_source(std::istream& s)
+	{
+		source = read_array <lab>()(s);
+		b_pop.init();
+		b_mass.init();
+	}
 
 //-----------------------------------------------------------------------------
 
@@ -287,6 +445,79 @@ public:
 
 //-----------------------------------------------------------------------------
 
+// trained leaves of init per dimension, on dimension range at
+template <typename T>
+void init_leaves(const tree <T>* init, const size_array& at,
+					  array <const tree <T>*>& leaf)
+{
+	if (!init) return;
+	if (at.length() == 1) { leaf[at[0]] = init; return; }
+	const node <T>* w = dynamic_cast <const node <T>*>(init);
+	if (!w) return;
+	init_leaves(w->children(0), at[w->dims(0)], leaf);
+	init_leaves(w->children(1), at[w->dims(1)], leaf);
+}
+
+// dimensions of range at, split as by train_node, that are not under any
+// inner subtree resumed from its checkpoint; only these need a batch leaf
+inline void
+batch_dims(const size_array& at, const train_options& opt, size_array& dims)
+{
+	if (at.empty()) return;
+	if (at.length() == 1) { dims.push_back(at[0]); return; }
+	if (resumable(at, opt)) return;
+	batch_dims(at[(0, _, at.length() / 2 - 1)], opt, dims);
+	batch_dims(at[(at.length() / 2, _, at.length() - 1)], opt, dims);
+}
+
+// leaves of data X on dimensions at in one batch, in parallel over
+// dimensions, each starting from init[d] if any; leaf[d] is the leaf of
+// dimension d, the same as if trained by the recursion
+template <typename T>
+class train_leaves
+{
+	typedef array <array <T> > data;
+
+	const data& X;
+	const size_array& dims;
+	const train_options& opt;
+	const array <const tree <T>*>& init;
+	array <train_tree <T>*>& leaf;
+
+public:
+
+	train_leaves(const data& X, const size_array& at,
+					 const train_options& opt, task_pool& pool,
+					 const array <const tree <T>*>& init,
+					 array <train_tree <T>*>& leaf) :
+		X(X), dims(at), opt(opt), init(init), leaf(leaf)
+	{
+		leaf.init(X.length(), (train_tree <T>*) 0);
+		pool.parallel(dims.length(), 1, *this);
+	}
+
+	void operator()(size_t begin, size_t end, size_t)
+	{
+		for (size_t i = begin; i < end; i++)
+		{
+			const size_t d = dims[i];
+			const size_array at(1, d);
+			train_tree <T>* book = resume(X, at, opt);
+			if (!book)
+			{
+				book = new train_leaf <T>(X[d], opt,
+				                          train_tree <T>::seed(opt, at),
+				                          init.empty() ? 0 : init[d]);
+				book->cache = opt.cache << 20;
+				checkpoint(book, opt, at);
+			}
+			leaf[d] = book;
+		}
+	}
+};
+
+//-----------------------------------------------------------------------------
+
 }  // namespace drvq
 
 #endif  // TRAIN_LEAF_HPP
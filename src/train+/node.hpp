@@ -30,7 +30,9 @@
 #ifndef TRAIN_NODE_HPP
 #define TRAIN_NODE_HPP
 
-#include "prop.hpp"
+#include <algorithm>
+#include <vector>
+#include "coarse.hpp"
 
 namespace drvq {
 
@@ -51,7 +53,11 @@ class train_node : public node <T>, public train_tree <T>
 	typedef typename tree <T>::data data;               // data type
 	typedef typename train_tree <T>::count count;       // count type
 	typedef typename train_tree <T>::book book;         // codeword type
-	typedef sample_search_generator <count> generator;  // random generator type
+	typedef sample_search_generator <count, pos> generator;  // random generator type
+	typedef bin_record <T, lab, count> record;             // per-bin record type
+
+	enum { grain = 4096, slices = 16 };  // minimum bins per slice, maximum slices in centroid update
+	enum { over = 4, most = 1 << 14 };   // candidate bins per centroid, and at most, in k-means++ seeding
 
 	const size_t D, D0, D1, L;        // dimensions, child dimensions, level
 	using node <T>::K;                // number of centroids
@@ -68,37 +74,85 @@ class train_node : public node <T>, public train_tree <T>
 	array <lab> label;                // centroid label per data point
 
 	// temporary
-	array_2d <count> b_pop;           // population per bin
-	array_2d <T> distance;            // distance from centroid on grid
+	tile_grid <count> b_pop;          // population per bin
+	tile_grid <record> bins;          // distance, label, state and population per bin
+	array_2d <T> dist0, dist1;        // centroid distances to children centroids
 	generator gen;                    // random sample generator
-	array_2d <char> chosen;           // is each bin chosen as a sample?  // TODO: char -> bool
+	tile_grid <char> chosen;          // is each bin chosen as a sample?  // TODO: char -> bool
+	std::vector <T> flat0, flat1;     // children centroids, D0 / D1 values per centroid
+	pool_buffer <T> sums;             // centroid sums per slice, D values per centroid
+	pool_buffer <count> pops;         // populations per slice
+	task_pool* pool;                  // training threads
+	size_t changed;                   // target bins changing label @ last assignment
+	double distortion;                // distortion @ last assignment
+	coarse_grid <T, lab, pos, count> coarse;  // coarse grid of multigrid schedule, if any
 
 //-----------------------------------------------------------------------------
 
 	void train
 	(
-		const data& X,          // data points
-		const size_array& at,   // dimension range
-		const train_options& opt  // training options
+		const data& X,            // data points
+		const size_array& at,     // dimension range
+		const train_options& opt, // training options
+		task_pool& pool,          // training threads
+		array <train_tree <T>*>* leaf  // leaf per dimension, if trained in batch
 	)
 	{
+		this->pool = &pool;
+
 		// trivial cases
 		if(K < 2) return;
 
-		// recurse
+		// recurse; children share nothing, so child1 may be stolen by
+		// another thread while child0 is trained here
 		// TODO: X, at[dim_] -> X[dim_]
-		child0 = drvq::train(X, at[dim0], opt);
-		child1 = drvq::train(X, at[dim1], opt);
+		const node <T>* w = dynamic_cast <const node <T>*>(this->init);
+		train_task <T> task1(X, at[dim1], opt, pool, w ? w->children(1) : 0, leaf);
+		pool.spawn(task1);
+		child0 = drvq::train(X, at[dim0], opt, pool, w ? w->children(0) : 0, leaf);
+		pool.sync(task1);
+		child1 = task1.book;
 		node <T>::child0 = static_cast <tree <T>*> (child0);
 		node <T>::child1 = static_cast <tree <T>*> (child1);
 
+		// quantize data points into bins
+		b_pop.recycle(&pool.buffers());        // tiles shared with other nodes
+		b_pop.init(idx(J, J), count(0));       // population per bin
+		array <pos> code =                     // nearest bin per data point
+			(child0 -> labels()) + J * (child1 -> labels());
+		child0 -> unlabel();                   // children labels no longer needed,
+		child1 -> unlabel();                   // so leaves of a batch free them early
+		for (size_t n = 0; n < code.length(); n++)
+			b_pop[code[n]]++;
+
+		train(at, opt, pool);
+
+		// store data labels
+		label = source[code];
+	}
+
+	// train on populations per bin, given trained children
+	void train
+	(
+		const size_array& at,     // dimension range
+		const train_options& opt, // training options
+		task_pool& pool           // training threads
+	)
+	{
+		this->pool = &pool;
+
+		// trivial cases
+		if(K < 2) return;
+
 		// children centroids
-		const array <array <T> > &cen0 = child0 -> centroids(),
-		                         &cen1 = child1 -> centroids();
+		flatten(child0 -> centroids(), D0, flat0);
+		flatten(child1 -> centroids(), D1, flat1);
 
-		bool detail = J >= 512;                // detailed messages
-		msg::level(info, L, at, K, J, detail);
-		msg::nl(info, detail);
+		// detailed messages span several calls per line; with more than one
+		// thread, only print one line per node when it terminates
+		bool detail = J >= 512 && pool.threads() == 1;
+		if (detail) msg::level(info, L, at, K, J, detail);
+		if (detail) msg::nl(info);
 
 		// initialize
 		if (detail) msg::in_line(info, "initializing");
@@ -106,62 +160,77 @@ class train_node : public node <T>, public train_tree <T>
 		const size_array grid = idx(J, J);     // grid dimensions
 		size_array zero, nz;                   // empty and non-empty bins
 
-		// quantize data points into bins
+		// populated bins
 		array <count> pop(K, 1);               // population per centroid
-		b_pop.init(grid, count(0));            // population per bin
-		array <pos> code =                     // nearest bin per data point
-			(child0 -> labels()) + J * (child1 -> labels());
-		b_pop[code]++;
-		size_array dom = find(b_pop);          // domain to visit
+		size_array dom = b_pop.find();         // domain to visit
+		array <count> d_pop(dom.length());     // population per domain bin
+		for (size_t i = 0; i < dom.length(); i++)
+			d_pop[i] = b_pop[dom[i]];
+		b_pop.init(0);
+		bins.recycle(&pool.buffers());         // tiles shared with other nodes
+		bins.init(grid);                       // per-bin records on grid
+		bin_layout(bins, opt.layout, opt.range,
+		           child0 -> edges(), child0 -> weights(),
+		           child1 -> edges(), child1 -> weights());
+		for (size_t i = 0; i < dom.length(); i++)
+			bins[dom[i]].pop = d_pop[i];
 
 		// initialize centroids
 		cen.init(D);                           // centroids (vectors)
 		for (size_t d = 0; d < D; d++)
 			cen[d].init(K, T());
-		gen = sample_search(b_pop);            // generator on bin distribution
+		gen = sample_search(dom, d_pop,        // generator on bin distribution
+		                    train_tree <T>::seed(opt, at));
+		chosen.recycle(&pool.buffers());
 		chosen.init(grid, false);              // is each bin chosen as a sample?
-		sample();
+		if (!warm())
+		{
+			if (opt.seeding == train_options::plus) sample_plus(opt, at);
+			else sample();
+		}
 
-		// initialize assignments
+		// initialize assignments, on the coarsest grid of the schedule
+		size_t level = opt.multigrid;          // coarse grid level; 0 for full grid
+		coarsen(level, dom, d_pop, at, opt, detail);
 		assign(true, types::t_false(), opt, detail);
-		array_2d <lab> prev = source;          // bin labels @ previous iteration
+		double last_dist = distortion;         // distortion @ previous iteration
+		size_t start = 0;                      // first iteration on current level
 
 		for (size_t it = 0; ; it++)
 		{
 			if (detail) msg::iter(info, it);
 
-			// update populations
-			pop[_] = 0;
-			pop[source[dom]] += b_pop[dom];
-			(_, zero, nz) = split++(pop == count(0));
+			// previous centroids
+			array <array <T> > last = cen;
 
-			// update centroids
-			for (size_t d = 0; d < D; d++)
-			{
-				cen[d][nz] = T();
-				if (d < D0) cen[d][source[dom]] += b_pop[dom] * cen0[d]     [dom % J];
-				else        cen[d][source[dom]] += b_pop[dom] * cen1[d - D0][dom / J];
-			}
-			for (size_t d = 0; d < D; d++)
-				cen[d][nz] /= pop[nz];
+			// update populations and centroids
+			average(dom, d_pop, pop);
+			(_, zero, nz) = split++(pop == count(0));
 
 			// re-sample empty centroids
 			sample(zero);
 
 			// update assignments
-			assign(false, types::t_false(), opt, detail);
-
-			// OPTIONAL: total distortion (sum of square residuals)
-			// T distortion = sum(b_pop * distance);
-
-			// terminate?
-			double ratio = opt.theta * _[it * .01] ->* 2;
-			if (find((source != prev)[dom]).length() < dom.length() * ratio)
+			array <char> moved =
+				refresh(last, zero, it ? tolerance(opt) : T(-1), detail);
+			if (opt.shift > 0 && coarse.empty()) reassign(moved, opt, detail);
+			else assign(false, types::t_false(), opt, detail);
+
+			// terminate, or refine?
+			const size_t n = coarse.empty() ? dom.length() : coarse.size();
+			if (detail) msg::distortion(info, distortion, changed, n);
+			if (!train_tree <T>::converged(opt, it - start, changed, n,
+			                               distortion, last_dist))
+				continue;
+			if (!level)
 			{
-				if (!detail) msg::term(info, it);
+				if (!detail) msg::term(info, L, at, K, J, it);
 				break;
 			}
-			prev = source;
+			coarsen(--level, dom, d_pop, at, opt, detail);
+			assign(false, types::t_false(), opt, detail);
+			last_dist = distortion;
+			start = it + 1;
 		}
 
 		if (detail) msg::in_line(info, "terminating");
@@ -171,23 +240,164 @@ class train_node : public node <T>, public train_tree <T>
 
 		// re-assign, generating edges, and check for empty
 		assign(true, types::t_true(), opt, detail);
-		msg::zero(check, K, source[dom], b_pop[dom]);
+		msg::zero(check, K, source[dom], d_pop);
+		if (detail) msg::tiles(info, bins.tiles(), bins.capacity(),
+		                       bins.bytes());
 		if (detail) msg::edge(check, weight, opt.range);
 
-		// store data labels, release children
-		label = source[code];
+		// release children
 		child0 -> release();
 		child1 -> release();
 
 		// clear temporaries
-		b_pop.init(idx(0, 0));     // TODO: init()
-		distance.init(idx(0, 0));  // TODO: init()
+		bins.init(0);
+		dist0.init(idx(0, 0));     // TODO: init()
+		dist1.init(idx(0, 0));     // TODO: init()
 		gen.clear();
-		chosen.init(idx(0, 0));    // TODO: init()
+		chosen.init(0);
+		coarse.clear();
+		std::vector <T>().swap(flat0);
+		std::vector <T>().swap(flat1);
+		sums.reset();
+		pops.reset();
+	}
+
+//-----------------------------------------------------------------------------
+
+	// centroids c with E dimensions, stored contiguously per centroid
+	static void flatten(const array <array <T> >& c, const size_t E,
+							  std::vector <T>& flat)
+	{
+		const size_t n = E ? c[0].length() : 0;
+		flat.assign(n * E, T());
+		for (size_t d = 0; d < E; d++)
+			for (size_t j = 0; j < n; j++)
+				flat[j * E + d] = c[d][j];
+	}
+
+	// sum children centroids of domain bins [begin, end), weighted by
+	// population, into slice s, per label; one pass over bins, with all
+	// dimensions of a bin accumulated in contiguous loops
+	void sum(const size_array& dom, const array <count>& d_pop,
+				const size_t begin, const size_t end, const size_t s)
+	{
+		T* acc = &sums[s * K * D];
+		count* p = &pops[s * K];
+		std::fill(acc, acc + K * D, T());
+		std::fill(p, p + K, count(0));
+
+		for (size_t i = begin; i < end; i++)
+		{
+			const pos q = dom[i];
+			const lab k = source[q];
+			const T w = d_pop[i];
+			p[k] += d_pop[i];
+
+			T* a = acc + k * D;
+			const T* c0 = &flat0[(q % J) * D0];
+			const T* c1 = &flat1[(q / J) * D1];
+			for (size_t d = 0; d < D0; d++)
+				a[d] += w * c0[d];
+			for (size_t d = 0; d < D1; d++)
+				a[D0 + d] += w * c1[d];
+		}
+	}
+
+	// merge slices in order into populations and centroids [begin, end);
+	// each row is accumulated in place into slice 0, which only this chunk
+	// touches, so no scratch is needed; empty centroids are kept
+	void merge(array <count>& pop, const size_t S,
+				  const size_t begin, const size_t end)
+	{
+		for (size_t k = begin; k < end; k++)
+		{
+			count n = 0;
+			for (size_t s = 0; s < S; s++)
+				n += pops[s * K + k];
+			pop[k] = n;
+			if (!n) continue;
+
+			T* row = &sums[k * D];
+			for (size_t s = 1; s < S; s++)
+			{
+				const T* a = &sums[(s * K + k) * D];
+				for (size_t d = 0; d < D; d++)
+					row[d] += a[d];
+			}
+			for (size_t d = 0; d < D; d++)
+				cen[d][k] = row[d] / n;
+		}
+	}
+
+	struct sum_body
+	{
+		train_node& N;
+		const size_array& dom;
+		const array <count>& d_pop;
+		const size_t S;
+
+		sum_body(train_node& N, const size_array& dom,
+					const array <count>& d_pop, const size_t S) :
+			N(N), dom(dom), d_pop(d_pop), S(S) { }
+
+		void operator()(size_t begin, size_t end, size_t)
+		{
+			const size_t n = dom.length();
+			for (size_t s = begin; s < end; s++)
+				N.sum(dom, d_pop, n * s / S, n * (s + 1) / S, s);
+		}
+	};
+
+	struct merge_body
+	{
+		train_node& N;
+		array <count>& pop;
+		const size_t S;
+
+		merge_body(train_node& N, array <count>& pop, const size_t S) :
+			N(N), pop(pop), S(S) { }
+
+		void operator()(size_t begin, size_t end, size_t)
+		{
+			N.merge(pop, S, begin, end);
+		}
+	};
+
+	// population and mean of children centroids of domain bins, per label;
+	// the domain is split in a number of slices that does not depend on the
+	// number of threads, and slices are merged in order, so the outcome is
+	// the same for any number of threads
+	void average(const size_array& dom, const array <count>& d_pop,
+					 array <count>& pop)
+	{
+		const size_t n = dom.length() / grain;
+		const size_t S = n < 1 ? 1 : n < slices ? n : slices;
+		sums.init(pool->buffers(), S * K * D);
+		pops.init(pool->buffers(), S * K);
+
+		sum_body slice(*this, dom, d_pop, S);
+		pool->parallel(S, 1, slice);
+		merge_body centroid(*this, pop, S);
+		pool->parallel(K, 64, centroid);
 	}
 
 //-----------------------------------------------------------------------------
 
+	// start from positions of centroids of trained node, if any and of
+	// equal capacities and dimensions
+	bool warm()
+	{
+		const node <T>* w = dynamic_cast <const node <T>*>(this->init);
+		if (!w || w->size() != K || w->side() != J ||
+		    w->dims(0).length() != D0 || w->dims(1).length() != D1)
+			return false;
+		code0 = w->codes(0);
+		code1 = w->codes(1);
+		for (size_t k = 0; k < K; k++)
+			chosen(code0[k], code1[k]) = true;
+		return true;
+	}
+
 	void sample()
 	{
 		array <pos> samp = gen(K, chosen);  // samples with replacement
@@ -195,6 +405,71 @@ class train_node : public node <T>, public train_tree <T>
 		code1 = samp / J;
 	}
 
+	// k-means++ seeding on at most over * K candidate bins, capped to most,
+	// drawn in proportion to population; duplicates are merged into distinct
+	// bins weighted by multiplicity. Each centroid is drawn among candidates
+	// in proportion to weight times squared distance to its nearest centroid
+	// so far, read off the rows of children distance tables and updated
+	// incrementally. O(K) rows and O(K * min(over * K, most)) additions
+	void sample_plus(const train_options& opt, const size_array& at)
+	{
+		const size_t M = std::min(size_t(over) * K, size_t(most));
+		std::vector <pos> draw(M);
+		for (size_t m = 0; m < M; m++)
+			draw[m] = gen();
+		std::sort(draw.begin(), draw.end());
+
+		std::vector <pos> cand;             // distinct candidate bins
+		std::vector <double> w;             // multiplicity per candidate
+		for (size_t m = 0; m < M; m++)
+			if (cand.empty() || draw[m] != cand.back())
+			{
+				cand.push_back(draw[m]);
+				w.push_back(1);
+			}
+			else w.back()++;
+
+		const size_t C = cand.size();
+		std::vector <double> d2(C, 1);      // squared distance to nearest centroid
+		double total = M;                   // sum of w * d2
+		random_engine engine(mix_seed(train_tree <T>::seed(opt, at), K, M));
+
+		for (size_t k = 0; k < K; k++)
+		{
+			// draw in proportion to w, then to w * d2; from the population
+			// if all candidates are taken
+			pos p;
+			if (total > 0)
+			{
+				double r = engine.uniform() * total;
+				size_t m = 0, last = 0;  // last candidate of positive weight
+				for (; m < C; m++)
+				{
+					const double q = w[m] * d2[m];
+					if (q <= 0) continue;
+					last = m;
+					if ((r -= q) < 0) break;
+				}
+				p = cand[m < C ? m : last];  // r left over by rounding
+			}
+			else p = gen(chosen);
+			chosen(p % J, p / J) = true;
+			code0[k] = p % J;
+			code1[k] = p / J;
+
+			// nearest centroid distances
+			const array_2d <T> r0 = child0 -> pair2(size_array(1, code0[k])),
+			                   r1 = child1 -> pair2(size_array(1, code1[k]));
+			total = 0;
+			for (size_t m = 0; m < C; m++)
+			{
+				const double d = r0(0, cand[m] % J) + r1(0, cand[m] / J);
+				if (!k || d < d2[m]) d2[m] = d;
+				total += w[m] * d2[m];
+			}
+		}
+	}
+
 	void sample(const size_array& which)
 	{
 		size_t k = which.length();
@@ -209,31 +484,31 @@ class train_node : public node <T>, public train_tree <T>
 	void assign(bool quantized, const TERM term,
 					const train_options& opt, bool detail)
 	{
-		if (opt.hash)
-			assign(quantized, term, types::t_true(), opt, detail);
-		else
-			assign(quantized, term, types::t_false(), opt, detail);
+		switch (opt.queue)
+		{
+			case train_options::heap:
+				assign(quantized, term, queue_kind <train_options::heap>(), opt, detail);
+				return;
+			case train_options::hash:
+				assign(quantized, term, queue_kind <train_options::hash>(), opt, detail);
+				return;
+			case train_options::radix:
+				assign(quantized, term, queue_kind <train_options::radix>(), opt, detail);
+				return;
+		}
 	}
 
-	template <typename TERM, typename HASH>
-	void assign(bool quantized, TERM term, HASH,
+	// propagate; when quantized, centroids are at their codes, otherwise
+	// distances and codes are already refreshed
+	template <typename TERM, int Q>
+	void assign(bool quantized, TERM term, queue_kind <Q>,
 					const train_options& opt, bool detail)
 	{
-		// find distances between centroids and child centroids
-		array_2d <T> dist0 = quantized ? child0 -> dist2(code0) :
-		                                 child0 -> dist2(cen, dim0);
-		array_2d <T> dist1 = quantized ? child1 -> dist2(code1) :
-		                                 child1 -> dist2(cen, dim1);
-
-		// quantize centroids
-		if (!quantized)
+		// find distances between quantized centroids and child centroids
+		if (quantized)
 		{
-			for (size_t k = 0; k < K; k++)
-			{
-				code0[k] = arg_min(dist0.as_rows()[k]);  // TODO: code0 = arg_min[1](dist0);
-				code1[k] = arg_min(dist1.as_rows()[k]);
-			}
-			chosen[code0 + J * code1] = true;
+			dist0 = child0 -> pair2(code0);
+			dist1 = child1 -> pair2(code1);
 		}
 
 		// get child edges
@@ -242,14 +517,154 @@ class train_node : public node <T>, public train_tree <T>
 		const array <array <T> > &weight0 = child0 -> weights(),
 		                         &weight1 = child1 -> weights();
 
+		// propagate on coarse grid, if any and with enough domain bins to
+		// hold all centroids; never when terminating
+		if (!coarse.empty() && coarse.size() >= K)
+		{
+			coarse(dist0, dist1, code0, code1, source, queue_kind <Q>(),
+			       opt, detail);
+			changed = coarse.changed();
+			distortion = coarse.distortion();
+			return;
+		}
+
 		// propagate
-		prop <T, lab, pos, count, HASH>
-			P(source, distance, edge, weight,
+		prop <T, lab, pos, count, Q>
+			P(source, bins, edge, weight,
 		     code0, code1, dist0, dist1,
 		     edge0, edge1, weight0, weight1,
-		     b_pop, opt);
+		     opt);
 
 		P(gen, chosen, term, detail);
+		changed = P.changed();
+		distortion = P.distortion();
+	}
+
+	// coarse grid at given level of the multigrid schedule, merging children
+	// labels level times; none at level 0. Levels are dropped while the
+	// coarse domain has fewer bins than centroids
+	void coarsen(size_t& level, const size_array& dom,
+	             const array <count>& d_pop, const size_array& at,
+	             const train_options& opt, bool detail)
+	{
+		for (;; level--)
+		{
+			coarse.init(level, J, child0 -> edges(), child0 -> weights(),
+			            child1 -> edges(), child1 -> weights(), dom, d_pop,
+			            opt.range, mix_seed(train_tree <T>::seed(opt, at), level, J),
+			            pool->buffers());
+			if (!level || coarse.size() >= K) break;
+		}
+		if (detail && opt.multigrid) msg::grid(info, level, coarse.side());
+	}
+
+//-----------------------------------------------------------------------------
+
+	// squared shift tolerance for incremental assignment: opt.shift times
+	// the mean distance between centroids and child centroids
+	T tolerance(const train_options& opt) const
+	{
+		if (!(opt.shift > 0)) return T();
+		T mean_dist = T();
+		for (size_t k = 0; k < K; k++)
+			mean_dist += mean(dist0.as_rows()[k]) + mean(dist1.as_rows()[k]);
+		return opt.shift * mean_dist / K;
+	}
+
+	// re-compute distances to child centroids only for centroids shifted from
+	// last by more than tol, or re-sampled; all if tol < 0. Other rows are
+	// kept, since child codebooks are fixed while training
+	array <char> refresh(const array <array <T> >& last, const size_array& zero,
+								const T tol, bool detail)
+	{
+		// moved centroids
+		array <char> moved(K, false);
+		moved[zero] = true;
+		for (size_t k = 0; k < K; k++)
+		{
+			T s = T();
+			for (size_t d = 0; d < D; d++)
+				s += (cen[d][k] - last[d][k]) * (cen[d][k] - last[d][k]);
+			if (s > tol) moved[k] = true;
+		}
+		size_array which = find(moved);
+		if (detail) msg::moved(info, which.length(), K);
+
+		// distances of moved centroids only
+		if (which.length() == K)
+		{
+			dist0 = child0 -> dist2(cen, dim0);
+			dist1 = child1 -> dist2(cen, dim1);
+		}
+		else if (!which.empty())
+		{
+			data sub(D);
+			for (size_t d = 0; d < D; d++)
+				sub[d] = cen[d][which];
+			array_2d <T> sub0 = child0 -> dist2(sub, dim0),
+			             sub1 = child1 -> dist2(sub, dim1);
+			for (size_t i = 0; i < which.length(); i++)
+				for (size_t j = 0; j < J; j++)
+				{
+					dist0(which[i], j) = sub0(i, j);
+					dist1(which[i], j) = sub1(i, j);
+				}
+		}
+
+		// quantize moved centroids; codes of the rest are unchanged, or were
+		// re-sampled by propagation and are kept as such
+		for (size_t i = 0; i < which.length(); i++)
+		{
+			const size_t k = which[i];
+			code0[k] = arg_min(dist0.as_rows()[k]);  // TODO: code0 = arg_min[1](dist0);
+			code1[k] = arg_min(dist1.as_rows()[k]);
+		}
+		for (size_t k = 0; k < K; k++)
+			chosen(code0[k], code1[k]) = true;
+		return moved;
+	}
+
+//-----------------------------------------------------------------------------
+
+	// incremental assignment: only bins of moved centroids and of their
+	// neighbors are propagated again; the remaining grid is kept
+	void reassign(const array <char>& moved, const train_options& opt,
+					  bool detail)
+	{
+		switch (opt.queue)
+		{
+			case train_options::heap:
+				reassign(moved, queue_kind <train_options::heap>(), opt, detail);
+				return;
+			case train_options::hash:
+				reassign(moved, queue_kind <train_options::hash>(), opt, detail);
+				return;
+			case train_options::radix:
+				reassign(moved, queue_kind <train_options::radix>(), opt, detail);
+				return;
+		}
+	}
+
+	template <int Q>
+	void reassign(const array <char>& moved, queue_kind <Q>,
+					  const train_options& opt, bool detail)
+	{
+		// get child edges
+		const array <array <lab> > &edge0 = child0 -> edges(),
+		                           &edge1 = child1 -> edges();
+		const array <array <T> > &weight0 = child0 -> weights(),
+		                         &weight1 = child1 -> weights();
+
+		// propagate
+		prop <T, lab, pos, count, Q>
+			P(source, bins, edge, weight,
+		     code0, code1, dist0, dist1,
+		     edge0, edge1, weight0, weight1,
+		     opt);
+
+		P.update(gen, chosen, moved, detail);
+		changed = P.changed();
+		distortion = P.distortion();
 	}
 
 //-----------------------------------------------------------------------------
@@ -260,7 +675,10 @@ public:
 	(
 		const data& X,            // data points
 		const size_array& at,     // dimension range
-		const train_options& opt  // training options
+		const train_options& opt, // training options
+		task_pool& pool,          // training threads
+		const tree <T>* init = 0, // trained node to start from, if any
+		array <train_tree <T>*>* leaf = 0  // leaf per dimension, if trained in batch
 	) :
 		node <T>
 		(
@@ -273,8 +691,48 @@ public:
 		// TODO: at -> X
 		D(at.length()), D0(D / 2), D1(D - D0), L(log2_(D))
 	{
+		this->init = init;
 		// TODO: X, at -> X
-		this->train(X, at, opt);
+		this->train(X, at, opt, pool, leaf);
+	}
+
+	// trained, as written by write(), without type; children are trainable
+	// too, so that the node may be a child of a node in training
+	train_node(std::istream& s) :
+		node <T>(s, false),
+		D(dim0.length() + dim1.length()), D0(dim0.length()),
+		D1(dim1.length()), L(log2_(D)), pool(0)
+	{
+		child0 = read_train <T>(s);
+		child1 = read_train <T>(s);
+		node <T>::child0 = static_cast <tree <T>*> (child0);
+		node <T>::child1 = static_cast <tree <T>*> (child1);
+	}
+
+	// untrained, on untrained children, to accumulate data in blocks by
+	// add() and train by fit()
+	train_node
+	(
+		train_tree <T>* c0,       // left child
+		train_tree <T>* c1,       // right child
+		const size_array& at,     // dimension range
+		const train_options& opt  // training options
+	) :
+		node <T>
+		(
+			// TODO: at -> X
+			opt.cap[min(opt.cap.length() - 1, log2_(at.length()))],      // K
+			opt.cap[min(opt.cap.length() - 1, log2_(at.length()) - 1)],  // J
+			(0, _, at.length() / 2 - 1),                                 // dim0
+			(at.length() / 2, _, at.length() - 1)                        // dim1
+		),
+		// TODO: at -> X
+		D(at.length()), D0(D / 2), D1(D - D0), L(log2_(D)),
+		child0(c0), child1(c1), pool(0)
+	{
+		node <T>::child0 = static_cast <tree <T>*> (child0);
+		node <T>::child1 = static_cast <tree <T>*> (child1);
+		b_pop.init(idx(J, J), count(0));
 	}
 
 //-----------------------------------------------------------------------------
@@ -313,7 +771,62 @@ public:
 	virtual const array <array <T> >&
 	weights() const { return weight; }
 
-	virtual void release() { cen.init(); label.init(); }
+	virtual void release() { cen.init(); label.init(); this->uncache(); }
+	virtual void unlabel() { label.init(); }
+
+	virtual void unsource()
+	{
+		source.init(idx(0, 0));  // TODO: init()
+		child0 -> unsource();
+		child1 -> unsource();
+	}
+
+	virtual void restore(const book& c, const data& X, const size_array& at)
+	{
+		cen = c;
+		if (!X.empty()) label = quant(X, at);
+	}
+
+	virtual void add(const data& X, const size_array& at)
+	{
+		// TODO: (X, at[dim_]) -> (X[dim_])
+		array <pos> code =
+			child0 -> quant(X, at[dim0]) + J * child1 -> quant(X, at[dim1]);
+		for (size_t n = 0; n < code.length(); n++)
+			b_pop[code[n]]++;
+	}
+
+	virtual void fit(const size_array& at, const train_options& opt,
+						  task_pool& pool)
+	{
+		train(at, opt, pool);
+	}
+
+	virtual void write_stats(std::ostream& s) const
+	{
+		size_array dom = b_pop.find();
+		array <count> d_pop(dom.length());
+		for (size_t i = 0; i < dom.length(); i++)
+			d_pop[i] = b_pop[dom[i]];
+		write_array(dom, s);
+		write_array(d_pop, s);
+	}
+
+	virtual void read_stats(std::istream& s)
+	{
+		size_array dom = read_array <size_t>()(s);
+		array <count> d_pop = read_array <count>()(s);
+		for (size_t i = 0; i < dom.length(); i++)
+			b_pop[dom[i]] += d_pop[i];
+	}
+
+	virtual void write_source(std::ostream& s) const { write_array_2d(source, s); }
+
+	virtual void read_source(std::istream& s)
+	{
+		source = read_array_2d <array <lab> >()(s);
+		b_pop.init(0);
+	}
 
 //-----------------------------------------------------------------------------
 
@@ -31,6 +31,7 @@
 #define TRAIN_PROP_HPP
 
 #include "queue.hpp"
+#include "bin.hpp"
 
 namespace drvq {
 
@@ -43,21 +44,89 @@ using ivl::sort;
 
 //-----------------------------------------------------------------------------
 
+// set of unordered pairs of labels, by open addressing with linear probing;
+// memory is proportional to the number of pairs
+class edge_set
+{
+	typedef unsigned long long word;
+
+	std::vector <word> slot;  // pairs, or empty
+	size_t size;              // number of pairs
+
+	static word empty() { return ~word(0); }
+
+	static word key(size_t a, size_t b)
+	{
+		if (a > b) std::swap(a, b);
+		return word(a) << 32 | b;
+	}
+
+	size_t find(const word k) const
+	{
+		const size_t mask = slot.size() - 1;
+		size_t i = size_t((k * 0x9E3779B97F4A7C15ULL) >> 20) & mask;
+		while (slot[i] != k && slot[i] != empty())
+			i = (i + 1) & mask;
+		return i;
+	}
+
+	void grow()
+	{
+		std::vector <word> old(2 * slot.size(), empty());
+		old.swap(slot);
+		for (size_t i = 0; i < old.size(); i++)
+			if (old[i] != empty()) slot[find(old[i])] = old[i];
+	}
+
+public:
+
+	edge_set() : slot(16, empty()), size(0) { }
+
+	void clear() { std::vector <word>(16, empty()).swap(slot); size = 0; }
+
+	bool has(const size_t a, const size_t b) const
+	{
+		return slot[find(key(a, b))] != empty();
+	}
+
+	// insert pair; false if already present
+	bool insert(const size_t a, const size_t b)
+	{
+		const word k = key(a, b);
+		size_t i = find(k);
+		if (slot[i] == k) return false;
+		slot[i] = k;
+		if (2 * ++size > slot.size()) grow();
+		return true;
+	}
+};
+
+//-----------------------------------------------------------------------------
+
 template <
 	typename T, typename lab, typename pos, typename count,
-	typename HASH = types::t_false
+	int Q = train_options::heap
 >
 class prop
 {
 //-----------------------------------------------------------------------------
 
-	typedef array_2d <pos> REF;
-	typedef queue <pos, T, REF, HASH::value> QUEUE;
-	typedef sample_search_generator <count> generator;
+	typedef bin_record <T, lab, count> record;
+	typedef typename record::index index;
+	typedef bin_order <record> REF;
+	typedef bin_distance <record, T> KEY;
+	typedef typename types::t_expr <Q == train_options::hash>::type HASH;
+	typedef typename types::t_expr <Q == train_options::radix>::type RADIX;
+	typedef typename types::t_if <
+		RADIX,
+		radix_queue <pos, T, KEY>,
+		queue <pos, T, REF, HASH::value>
+	>::type QUEUE;
+	typedef sample_search_generator <count, pos> generator;
 
 	// output
 	array_2d <lab>& source;      // nearest centroid label on grid
-	array_2d <T>& distance;      // distance from centroid on grid
+	tile_grid <record>& bins;    // distance, label, state and population per bin
 	array <array <lab> >& edge;  // edges between neighboring centroids
 	array <array <T> >& weight;  // edge weights
 
@@ -72,20 +141,22 @@ class prop
 	const array <array <lab> >& edge1;  // child1 edges
 	const array <array <T> >& weight0;  // child0 edge weights
 	const array <array <T> >& weight1;  // child1 edge weights
-	const array_2d <count>& target;     // target domain to visit
+	const tile_grid <record>& target;   // bins, read without allocating
 
 	// options
 	const train_options& opt;
 
 	// temporary
-	array_2d <pos> order;      // position in queue
-	array_2d <pos>& state;     // alias of position as state
+	REF order;                 // position in queue, or state
+	KEY key;                   // distance, as queue key
 	QUEUE front;               // propagating front
-	array_2d <char> adjacent;  // centroid adjacency matrix  // TODO: char -> bool
+	edge_set adjacent;         // pairs of adjacent centroids
 	array <T> far;             // mean distance per centroid
 
 	// state
-	const pos alive, burnt;
+	const index alive, burnt;
+	size_t moves;              // target bins changing label, at output
+	double loss;               // distortion on target, at output
 
 public:
 
@@ -95,7 +166,7 @@ public:
 	(
 		// output
 		array_2d <lab>& source,
-		array_2d <T>& distance,
+		tile_grid <record>& bins,
 		array <array <lab> >& edge,
 		array <array <T> >& weight,
 
@@ -108,14 +179,13 @@ public:
 		const array <array <lab> >& edge1,
 		const array <array <T> >& weight0,
 		const array <array <T> >& weight1,
-		const array_2d <count>& target,
 
 		// options
 		const train_options& opt
 	) :
 
 		// output
-		source(source), distance(distance), edge(edge), weight(weight),
+		source(source), bins(bins), edge(edge), weight(weight),
 
 		// input
 		K(dist0.rows()), J(dist0.columns()),
@@ -123,23 +193,29 @@ public:
 		dist0(dist0), dist1(dist1),
 		edge0(edge0), edge1(edge1),
 		weight0(weight0), weight1(weight1),
-		target(target),
+		target(bins),
 
 		// options
 		opt(opt),
 
 		// temporary
-		state(order), front(order),
-		alive(-1), burnt(-2)
+		order(bins), key(bins), front(order, key),
+		alive(record::alive()), burnt(record::burnt()),
+		moves(0), loss(0)
 		{ }
 
+	// target bins changing label, and total distortion (sum of population
+	// times distance), both accumulated at output
+	size_t changed() const { return moves; }
+	double distortion() const { return loss; }
+
 //-----------------------------------------------------------------------------
 
 	template <typename TERM>
 	void operator()
 	(
 		const generator& gen,     // random sample generator
-		array_2d <char>& chosen,  // is each bin chosen as a sample?  // TODO: char -> bool
+		tile_grid <char>& chosen, // is each bin chosen as a sample?  // TODO: char -> bool
 		const TERM term,          // terminate (compute edges)
 		const bool detail         // detailed messages
 	)
@@ -147,28 +223,22 @@ public:
 		// initialize edges
 		if (term)
 		{
-			adjacent.init(idx(K, K), false);  // TODO: init(K, K, false)
+			adjacent.clear();
 			for (size_t k = 0; k < K; k++)  // loops always first
 			{
 				edge[k].push_back(k);
 				weight[k].push_back(0);
-				adjacent(k, k) = true;
 			}
 		}
 
 		// initialize grid
 		const size_t B = J * J;             // number of bins on grid
-		const size_array grid = idx(J, J);  // grid size
-		distance.init(grid, T());           // distance on grid  // TODO: remove T()
-		state.init(grid, alive);            // state on grid
-		size_t total =
-			find(target).length();           // total number of bins to visit
-		size_t queue_length = 0;            // maximum queue length (info only)
-		size_t heap_length = 0;             // maximum heap length (info only)
-		pos p, n;                           // current point; neighbor point
-		T dist;                             // current distance
-		lab src;                            // p's source (nearest centroid)
-		lab c0, c1;                         // p's coordinates
+		bin_reset <record> reset(alive, true);
+		bins.each(reset);                   // state and distance on grid
+		bin_count <record> targets;
+		bins.each(targets);
+		size_t total = targets.n;           // total number of bins to visit
+		pos p;                              // current point
 
 		// mean distances per centroid
 		array <T> far0(K), far1(K);
@@ -186,13 +256,136 @@ public:
 		for (size_t k = 0; k < K; k++)
 		{
 			p = offset(code0[k], code1[k]);
-			if (state[p] != alive)
+			if (target[p].order != alive)
 				(_, code0[k], code1[k]) = coord(p = gen(chosen));
-			msg::collide(check, state, p, alive, k);
+			msg::collide(check, target[p].order, alive, k);
 			push(p, 0, k);
 			// push(p, dist0(k, code0[k]) + dist1(k, code1[k]), k);
 		}
 
+		spread(total, term, detail);
+		output();
+	}
+
+//-----------------------------------------------------------------------------
+
+	// propagate again after centroids marked in moved are displaced; only
+	// bins of moved centroids and of their neighbors are reset, seeded from
+	// the centroids and from the kept bins around them, and the rest of the
+	// grid is kept as is. Only allocated bins are scanned; labels are still
+	// output on the dense source grid, which the parent reads as a whole
+	void update
+	(
+		const generator& gen,        // random sample generator
+		tile_grid <char>& chosen,    // is each bin chosen as a sample?  // TODO: char -> bool
+		const array <char>& moved,   // has each centroid moved?
+		const bool detail            // detailed messages
+	)
+	{
+		const size_t B = J * J;             // number of bins on grid
+		array <char> reset = moved;         // is each centroid reset?
+		bin_select <record> at(moved);      // bins of moved centroids
+		size_t total = 0;                   // number of reset bins to visit
+		pos p, n;                           // current point; neighbor point
+		lab src;                            // n's source (nearest centroid)
+		lab c0, c1;                         // p's coordinates
+
+		// reset neighbors of moved centroids
+		bins.each(at);
+		for (size_t a = 0; a < at.pos.size(); a++)
+		{
+			(_, c0, c1) = coord(p = at.pos[a]);
+
+			const array <lab>& e0 = edge0[c0];
+			const array <T>& w0 = weight0[c0];
+			for (size_t i = 1; i < e0.length(); i++)  // skip self (loop)
+				if (w0[i] < opt.range) reset[source[offset(e0[i], c1)]] = true;
+
+			const array <lab>& e1 = edge1[c1];
+			const array <T>& w1 = weight1[c1];
+			for (size_t i = 1; i < e1.length(); i++)  // skip self (loop)
+				if (w1[i] < opt.range) reset[source[offset(c0, e1[i])]] = true;
+		}
+
+		// reset owners of bins where reset centroids now lie
+		for (size_t k = 0; k < K; k++)
+			if (reset[k]) reset[source[offset(code0[k], code1[k])]] = true;
+
+		// keep all other bins
+		bin_reset <record> keep(burnt, false);
+		bins.each(keep);
+		bin_select <record> region(reset);  // reset bins
+		bins.each(region);
+		for (size_t r = 0; r < region.pos.size(); r++)
+		{
+			record& b = bins[region.pos[r]];
+			b.order = alive;
+			if (b.pop) total++;
+		}
+
+		// initialize hash queue
+		init_queue(B, HASH());
+
+		// initiate front from reset centroids, re-sampling when sources
+		// coincide; centroids re-sampled on kept bins are left out
+		for (size_t k = 0; k < K; k++)
+		{
+			if (!reset[k]) continue;
+			p = offset(code0[k], code1[k]);
+			if (target[p].order != alive)
+				(_, code0[k], code1[k]) = coord(p = gen(chosen));
+			msg::collide(check, target[p].order, alive, k);
+			if (target[p].order == alive) push(p, 0, k);
+		}
+
+		// initiate front from kept bins around the reset region
+		for (size_t r = 0; r < region.pos.size(); r++)
+		{
+			p = region.pos[r];
+			(_, c0, c1) = coord(p);
+
+			const array <lab>& e0 = edge0[c0];
+			const array <T>& w0 = weight0[c0];
+			for (size_t i = 1; i < e0.length(); i++)  // skip self (loop)
+			{
+				if (w0[i] >= opt.range) continue;
+				n = offset(e0[i], c1);
+				if (target[n].order != burnt) continue;
+				src = target[n].source;
+				move(p, dist0(src, c0) + dist1(src, c1), src, types::t_false());
+			}
+
+			const array <lab>& e1 = edge1[c1];
+			const array <T>& w1 = weight1[c1];
+			for (size_t i = 1; i < e1.length(); i++)  // skip self (loop)
+			{
+				if (w1[i] >= opt.range) continue;
+				n = offset(c0, e1[i]);
+				if (target[n].order != burnt) continue;
+				src = target[n].source;
+				move(p, dist0(src, c0) + dist1(src, c1), src, types::t_false());
+			}
+		}
+
+		spread(total, types::t_false(), detail);
+		output();
+	}
+
+//-----------------------------------------------------------------------------
+
+	// propagate front until total target bins are visited, or until the
+	// queue is empty when terminating
+	template <typename TERM>
+	void spread(const size_t total, const TERM term, const bool detail)
+	{
+		const size_t B = J * J;             // number of bins on grid
+		size_t queue_length = 0;            // maximum queue length (info only)
+		size_t heap_length = 0;             // maximum heap length (info only)
+		pos p, n;                           // current point; neighbor point
+		T dist;                             // current distance
+		lab src;                            // p's source (nearest centroid)
+		lab c0, c1;                         // p's coordinates
+
 		for (size_t visited = 0, b = 0; !front.empty(); b++)
 		{
 			if(detail)
@@ -205,8 +398,9 @@ public:
 
 			// select nearest point
 			p = front.pop();
-			state[p] = burnt;
-			src = source[p];
+			record& r = bins[p];
+			r.order = burnt;
+			src = r.source;
 			(_, c0, c1) = coord(p);
 
 			// propagate to c0's neighbors
@@ -231,19 +425,36 @@ public:
 
 			// terminate if all target bins are visited
 			if (term) continue;
-			if (target[p]) visited++;
+			if (r.pop) visited++;
 			if (visited == total) break;
 		}
 
 		if(detail)
 		{
 			msg::queue(info, queue_length, heap_length);
-			msg::visit(check, state, burnt, target, term);
+			msg::visit(check, alive_bins(), B, term);
 		}
 	}
 
 //-----------------------------------------------------------------------------
 
+	// number of target bins not visited (info only)
+	size_t alive_bins()
+	{
+		bin_count <record> alive_target(false);
+		bins.each(alive_target);
+		return alive_target.n;
+	}
+
+	// labels on dense grid
+	void output()
+	{
+		bin_source <record, array_2d <lab> > out(source);
+		bins.each(out);
+		moves = out.changed;
+		loss = out.distortion;
+	}
+
 	// coordinates to linear offset
 	pos offset(const lab row, const lab col) { return row + J * col; }
 
@@ -263,9 +474,10 @@ public:
 	template <typename TERM>
 	void move(const pos p, const T dist, const lab src, TERM term)
 	{
-		if (state[p] == burnt)
+		const index s = target[p].order;
+		if (s == burnt)
 			join(p, dist, src, term);
-		else if (state[p] == alive)
+		else if (s == alive)
 			push(p, dist, src);
 		else
 			relax(p, dist, src);
@@ -275,17 +487,21 @@ public:
 
 	void push(const pos p, const T dist, const lab src)
 	{
-		order[p] = front.seek(dist);
-		order[p] = front.push(p, distance[p] = dist);
-		source[p] = src;
+		record& b = bins[p];
+		b.order = front.seek(dist);
+		b.distance = dist;
+		b.order = front.push(p, dist);
+		b.source = src;
 	}
 
 	void relax(const pos p, const T dist, const lab src)
 	{
-		if (dist < distance[p])
+		record& b = bins[p];
+		if (dist < b.distance)
 		{
-			order[p] = front.up(order[p], p, distance[p] = dist);
-			source[p] = src;
+			b.distance = dist;
+			b.order = front.up(b.order, p, dist);
+			b.source = src;
 		}
 	}
 
@@ -297,13 +513,14 @@ public:
 	void join(const pos p, const T dist, const lab src,
 				 types::t_true)
 	{
-		const lab from = src, to = source[p];
-		if (adjacent(from, to)) return;
+		const record b = target[p];
+		const lab from = src, to = b.source;
+		if (from == to || adjacent.has(from, to)) return;
 
-		const T w = (dist + distance[p]) / max(far[from], far[to]);
+		const T w = (dist + b.distance) / max(far[from], far[to]);
 		if (w >= 1.5 * opt.range) return;
 
-		adjacent(from, to) = adjacent(to, from) = true;
+		adjacent.insert(from, to);
 		edge[from].push_back(to);
 		edge[to].push_back(from);
 		weight[from].push_back(w);
@@ -30,6 +30,9 @@
 #ifndef TRAIN_QUEUE_HPP
 #define TRAIN_QUEUE_HPP
 
+#include <cstring>
+#include <vector>
+
 namespace drvq {
 
 using namespace ivl;
@@ -110,6 +113,9 @@ public:
 
 	queue(REF& r) : swap(r) { heap_swap(heap, swap, FIBO()); }
 
+	template <typename KEY>
+	queue(REF& r, const KEY&) : swap(r) { heap_swap(heap, swap, FIBO()); }
+
 	void init(T, size_t) { }  // only for hash queue
 
 //-----------------------------------------------------------------------------
@@ -226,6 +232,9 @@ public:
 
 	queue(REF& r) : base(r) { init(); }
 
+	template <typename KEY>
+	queue(REF& r, const KEY& k) : base(r, k) { init(); }
+
 	void init(T bucket = 1, size_t H = 1)
 	{
 		this->bucket = bucket;
@@ -285,6 +294,172 @@ public:
 
 //-----------------------------------------------------------------------------
 
+// queue type tag, see train_options::queue_type
+template <int Q> struct queue_kind { };
+
+//-----------------------------------------------------------------------------
+
+// bits of a non-negative floating point key, in the same order as the key
+template <typename T> struct radix_key { };
+template <> struct radix_key <float>  { typedef unsigned int type; };
+template <> struct radix_key <double> { typedef unsigned long long type; };
+
+//-----------------------------------------------------------------------------
+
+// monotone radix heap on non-negative floating point keys. Each job is kept
+// in the bucket of the highest bit where its key differs from the last popped
+// key, so push and decrease-key are O(1), and each job is moved at most once
+// per bit over all pops. Decrease-key pushes a new copy of the job instead of
+// locating the old one, hence no positions are maintained; a copy is stale if
+// its time differs from the current key of its data, or if its data is no
+// longer queued (a copy pushed at an equal time), and is dropped when met.
+// The front is not strictly monotone, so keys below the last popped one go
+// to the lowest bucket, as in the hash queue. The lowest bucket is popped in
+// FIFO order, so ties are broken by insertion rather than by heap order.
+template <typename D, typename T, typename KEY>
+class radix_queue
+{
+	typedef typename radix_key <T>::type bits;
+	enum { B = 8 * sizeof(bits) + 1 };  // number of buckets
+
+	struct job
+	{
+		D data;
+		T time;
+		job() { }
+		job(const D& d, const T& t) : data(d), time(t) { }
+	};
+
+	typedef std::vector <job> entry;
+	typedef std::vector <bool> flags;
+
+//-----------------------------------------------------------------------------
+
+	const KEY& key;     // current time per data
+	entry bucket[B];    // jobs per highest differing bit
+	size_t head;        // next job to pop in the lowest bucket
+	flags in;           // queued flag per data
+	bits last;          // last popped key
+	size_t live;        // number of jobs, excluding stale copies
+	size_t total;       // number of jobs, including stale copies
+
+//-----------------------------------------------------------------------------
+
+	static bits to_bits(const T t)
+	{
+		bits b;
+		std::memcpy(&b, &t, sizeof(b));
+		return b;
+	}
+
+	size_t index(const T t) const
+	{
+		bits x = to_bits(t);
+		if (x <= last) return 0;
+		return 8 * sizeof(unsigned long long) -
+			__builtin_clzll((unsigned long long)(x ^ last));
+	}
+
+	bool stale(const job& j) const
+	{
+		return j.data >= in.size() || !in[j.data] || j.time != key[j.data];
+	}
+
+	void add(const job& j) { bucket[index(j.time)].push_back(j); total++; }
+
+	// redistribute the lowest non-empty bucket, dropping stale copies
+	void scan()
+	{
+		for (size_t i = 1; i < B; i++)
+		{
+			entry& b = bucket[i];
+			size_t n = 0, N = b.size();
+			for (size_t k = 0; k < N; k++)
+				if (!stale(b[k])) b[n++] = b[k];
+			total -= N;
+			b.resize(n);
+			if (!n) continue;
+
+			T t = b[0].time;
+			for (size_t k = 1; k < n; k++)
+				if (b[k].time < t) t = b[k].time;
+			last = to_bits(t);
+
+			for (size_t k = 0; k < n; k++)
+				add(b[k]);
+			b.clear();
+			return;
+		}
+	}
+
+//-----------------------------------------------------------------------------
+
+public:
+
+	template <typename REF>
+	radix_queue(REF&, const KEY& key) : key(key) { init(); }
+
+	void init(T = 0, size_t = 0)
+	{
+		for (size_t i = 0; i < B; i++)
+			bucket[i].clear();
+		in.clear();
+		last = 0;
+		head = live = total = 0;
+	}
+
+//-----------------------------------------------------------------------------
+
+	bool empty() { return live == 0; }
+
+	size_t size() { return live; }
+
+	size_t length() { return live; }
+
+	size_t level() { return 0; }
+
+	size_t heap_size() { return total; }
+
+	D pop()
+	{
+		CHECK(live, erange());
+		for (;;)
+		{
+			entry& b = bucket[0];
+			if (head == b.size())
+			{
+				b.clear();
+				head = 0;
+				scan();
+			}
+			job j = b[head++];
+			total--;
+			if (stale(j)) continue;
+			in[j.data] = false;
+			live--;
+			return j.data;
+		}
+	}
+
+	size_t up(const size_t, const D& data, const T& time)
+	{
+		add(job(data, time));
+		return 0;
+	}
+
+	size_t push(const D& data, const T& time)
+	{
+		if (data >= in.size()) in.resize(data + 1, false);
+		if (!in[data]) { in[data] = true; live++; }
+		add(job(data, time));
+		return 0;
+	}
+
+	size_t seek(const T&) { return 0; }
+};
+
+//-----------------------------------------------------------------------------
+
 }  // namespace drvq
 
 #endif // TRAIN_QUEUE_HPP
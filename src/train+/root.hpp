@@ -62,14 +62,60 @@ class train_root : public root <T>, public ofile <train_root <T> >
 		return opt.cap[min(opt.cap.length() - 1, log2_(div_ceil_(D, opt.books)))];
 	}
 
+	// codebook training as a task: all leaves in one batch, then nodes
+	struct book_task : public task
+	{
+		const data& X;             // data points
+		const size_t c;            // codebook index
+		const size_array at;       // dimension range
+		const train_options& opt;  // training options
+		task_pool& pool;           // training threads
+		const tree <T>* init;      // trained codebook to start from, if any
+		train_tree <T>* book;      // output codebook
+
+		book_task(const data& X, const size_t c, const size_array& at,
+					 const train_options& opt, task_pool& pool,
+					 const tree <T>* init) :
+			X(X), c(c), at(at), opt(opt), pool(pool), init(init), book(0) { }
+
+		void run()
+		{
+			msg::head(info, "training codebook ", c);
+			if (X.empty() || at.empty() || opt.cap.empty()) return;
+			array <const tree <T>*> start(X.length(), (const tree <T>*) 0);
+			init_leaves(init, at, start);
+
+			// leaves under the codebook or inner subtrees that resume from
+			// checkpoints are not trained; train() takes the rest
+			size_array dims;
+			batch_dims(at, opt, dims);
+			array <train_tree <T>*> leaf;
+			train_leaves <T> batch(X, dims, opt, pool, start, leaf);
+			book = train(X, at, opt, pool, init, &leaf);
+			for (size_t d = 0; d < leaf.length(); d++)
+				delete leaf[d];
+		}
+	};
+
+	// codebook c of init to start from, if on the same dimension range
+	const tree <T>* start(const root <T>* init, const size_t c) const
+	{
+		if (!init || c >= init->children()) return 0;
+		const size_array& d = init->dims(c);
+		return d.length() == dim[c].length() && d[0] == dim[c][0] ?
+			init->book(c) : 0;
+	}
+
 //-----------------------------------------------------------------------------
 
 public:
 
 	train_root
 	(
-		const data& X,             // data points
-		const train_options& opt   // training options
+		const data& X,               // data points
+		const train_options& opt,    // training options
+		task_pool& pool,             // training threads
+		const root <T>* init = 0     // trained codebooks to start from, if any
 	) :
 		root <T>(
 			opt.books,                    // C
@@ -77,14 +123,43 @@ public:
 			split(X.length(), opt.books)  // dim
 		)
 	{
+		// codebooks are independent; spawn in reverse so that a single
+		// thread trains them in order; each prints its header as it starts
+		array <book_task*> book(C);
+		for (size_t c = 0; c < C; c++)
+			book[c] = new book_task(X, c, dim[c], opt, pool, start(init, c));
+		for (size_t c = C; c-- > 1; )
+			pool.spawn(*book[c]);
+
 		for (size_t c = 0; c < C; c++)
 		{
-			msg::head(info, "training codebook ", c);
-			child[c] = train(X, dim[c], opt);
-			msg::nl(info);
+			c ? pool.sync(*book[c]) : book[c]->run();
+			child[c] = book[c]->book;
+			delete book[c];
 		}
 	}
 
+	// out-of-core, on data streamed from files
+	train_root
+	(
+		data_stream <T>& in,           // input data
+		const train_options& opt,      // training options
+		task_pool& pool,               // training threads
+		const file_exchange* ex = 0,   // exchange between shards, if distributed
+		const root <T>* init = 0       // trained codebooks to start from, if any
+	) :
+		root <T>(
+			opt.books,                    // C
+			capacity(in.dims(), opt),     // J
+			split(in.dims(), opt.books)   // dim
+		)
+	{
+		train_stream <T> S(in, opt, pool, ex);
+		for (size_t c = 0; c < C; c++)
+			child[c] = S.book(dim[c], start(init, c));
+		S();
+	}
+
 //-----------------------------------------------------------------------------
 
 	void write(std::ostream& s) const
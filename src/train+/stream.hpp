@@ -0,0 +1,350 @@
+/* This file is part of drvq library <http://image.ntua.gr/iva/tools/drvq>.
+   A C++ library for dimensionality-recursive vector quantization.
+
+   Copyright (c) 2013, Yannis Avrithis <iavr@image.ntua.gr>.
+   All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without modification,
+   are permitted provided that the following conditions are met:
+
+   * Redistributions of source code must retain the above copyright notice, this
+     list of conditions and the following disclaimer.
+
+   * Redistributions in binary form must reproduce the above copyright notice, this
+     list of conditions and the following disclaimer in the documentation and/or
+     other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+   ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+   WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+   ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+   ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
+
+
+//-----------------------------------------------------------------------------
+
+#ifndef TRAIN_STREAM_HPP
+#define TRAIN_STREAM_HPP
+
+#include <vector>
+
+namespace drvq {
+
+using namespace ivl;
+using namespace std;
+using ivl::min;
+using ivl::max;
+
+//-----------------------------------------------------------------------------
+
+// out-of-core training: subtrees are trained level by level, bottom-up, on
+// data streamed from files. A first pass finds the data interval per
+// dimension; then one pass per level accumulates populations per bin of all
+// subtrees of the level, quantizing through their trained children. Memory
+// is bounded by the grids rather than by the data.
+//
+// Distributed over processes, each streams its own shard of files. Data
+// intervals are exchanged between all; per level, workers send the
+// populations they accumulate to the coordinator (shard 0), which adds
+// them, trains the level, and sends back the grids of the level's subtrees,
+// so that workers can quantize through them in the next pass
+template <typename T>
+class train_stream
+{
+	typedef typename tree <T>::data data;  // data type
+
+	// untrained subtree on a dimension range
+	struct part
+	{
+		size_array at;
+		train_tree <T>* book;
+
+		part(const size_array& at, train_tree <T>* book) : at(at), book(book) { }
+	};
+
+	typedef std::vector <part> parts;
+
+	data_stream <T>& in;        // input data
+	const train_options& opt;   // training options
+	task_pool& pool;            // training threads
+	const file_exchange* ex;    // exchange between shards, if distributed
+	array <T> lo, hi;           // data interval per dimension
+	std::vector <parts> level;  // subtrees per height (0: leaves)
+
+//-----------------------------------------------------------------------------
+
+	// one pass over normalized data; f(X) per file
+	template <typename F>
+	void pass(F& f)
+	{
+		data X;
+		in.rewind();
+		while (in.next(X))
+		{
+			normalize(X, opt);
+			f(X);
+		}
+	}
+
+	struct range_body
+	{
+		array <T> &lo, &hi;
+		bool first;
+
+		range_body(array <T>& lo, array <T>& hi) : lo(lo), hi(hi), first(true) { }
+
+		void operator()(const data& X)
+		{
+			if (first) { lo.init(X.length()); hi.init(X.length()); }
+			for (size_t d = 0; d < X.length(); d++)
+			{
+				lo[d] = first ? min(X[d]) : std::min(lo[d], min(X[d]));
+				hi[d] = first ? max(X[d]) : std::max(hi[d], max(X[d]));
+			}
+			first = false;
+		}
+	};
+
+	// merge data intervals of all shards
+	struct range_io
+	{
+		array <T> &lo, &hi;
+
+		range_io(array <T>& lo, array <T>& hi) : lo(lo), hi(hi) { }
+
+		void operator()(std::ostream& s)
+		{
+			write_array(lo, s);
+			write_array(hi, s);
+		}
+
+		void operator()(std::istream& s)
+		{
+			array <T> l = read_array <T>()(s), h = read_array <T>()(s);
+			if (l.empty()) return;
+			if (lo.empty()) { lo = l; hi = h; return; }
+			for (size_t d = 0; d < lo.length(); d++)
+			{
+				lo[d] = std::min(lo[d], l[d]);
+				hi[d] = std::max(hi[d], h[d]);
+			}
+		}
+	};
+
+	// statistics of all subtrees of a level, in order
+	struct stats_io
+	{
+		parts& p;
+		stats_io(parts& p) : p(p) { }
+
+		void operator()(std::ostream& s)
+		{
+			for (size_t i = 0; i < p.size(); i++)
+				p[i].book -> write_stats(s);
+		}
+
+		void operator()(std::istream& s)
+		{
+			for (size_t i = 0; i < p.size(); i++)
+				p[i].book -> read_stats(s);
+		}
+	};
+
+	// grids of all subtrees of a level, in order
+	struct source_io
+	{
+		parts& p;
+		source_io(parts& p) : p(p) { }
+
+		void operator()(std::ostream& s)
+		{
+			for (size_t i = 0; i < p.size(); i++)
+				p[i].book -> write_source(s);
+		}
+
+		void operator()(std::istream& s)
+		{
+			for (size_t i = 0; i < p.size(); i++)
+				p[i].book -> read_source(s);
+		}
+	};
+
+//-----------------------------------------------------------------------------
+
+	// add data to all subtrees of a level, in parallel
+	struct add_body
+	{
+		parts& p;
+		task_pool& pool;
+		const data* X;
+
+		add_body(parts& p, task_pool& pool) : p(p), pool(pool), X(0) { }
+
+		void operator()(const data& Y)
+		{
+			X = &Y;
+			pool.parallel(p.size(), 1, *this);
+		}
+
+		void operator()(size_t begin, size_t end, size_t)
+		{
+			for (size_t i = begin; i < end; i++)
+				p[i].book -> add(*X, p[i].at);
+		}
+	};
+
+	// train a subtree on data accumulated, as a task
+	struct fit_task : public task
+	{
+		part* p;
+		const train_options* opt;
+		task_pool* pool;
+
+		void run() { p->book -> fit(p->at, *opt, *pool); }
+	};
+
+	// train all subtrees of a level; they are independent, so spawn in
+	// reverse such that a single thread trains them in order
+	void fit(parts& p)
+	{
+		std::vector <fit_task> t(p.size());
+		for (size_t i = 0; i < p.size(); i++)
+		{
+			t[i].p = &p[i];
+			t[i].opt = &opt;
+			t[i].pool = &pool;
+		}
+		for (size_t i = p.size(); i-- > 1; )
+			pool.spawn(t[i]);
+		for (size_t i = 0; i < p.size(); i++)
+			i ? pool.sync(t[i]) : t[i].run();
+		for (size_t i = 0; i < p.size(); i++)
+			checkpoint(p[i].book, opt, p[i].at);
+	}
+
+	// train a level, or exchange it if distributed
+	void fit(parts& p, const size_t h)
+	{
+		if (!ex)
+		{
+			fit(p);
+			return;
+		}
+
+		const string stats = "stats" + to_<string>(h),
+		             source = "source" + to_<string>(h);
+		stats_io s(p);
+		source_io g(p);
+		if (opt.shard)
+		{
+			ex->put(stats, opt.shard, s);
+			ex->get(source, 0, g);
+		}
+		else
+		{
+			for (size_t i = 1; i < opt.shards; i++)
+				ex->get(stats, i, s);
+			fit(p);
+			ex->put(source, 0, g);
+		}
+	}
+
+//-----------------------------------------------------------------------------
+
+	// height of subtree on dimension range of length D
+	static size_t height(const size_t D)
+	{
+		return D < 2 ? 0 : std::max(height(D / 2), height(D - D / 2)) + 1;
+	}
+
+	// untrained subtree on dimension range at, with its descendants, or
+	// trained if resumed from checkpoint; h is set to its height. Training
+	// starts from init, if any
+	train_tree <T>* plan(const size_array& at, size_t& h, const tree <T>* init)
+	{
+		train_tree <T>* book = resume(data(), at, opt);
+		if (book)
+		{
+			h = height(at.length());
+			return book;
+		}
+		if (at.length() == 1)
+		{
+			h = 0;
+			book = new train_leaf <T>(lo[at[0]], hi[at[0]], opt);
+		}
+		else
+		{
+			const size_t D0 = at.length() / 2;
+			size_t h0, h1;
+			const node <T>* w = dynamic_cast <const node <T>*>(init);
+			train_tree <T>* c0 = plan(at[0, _, D0 - 1], h0, w ? w->children(0) : 0);
+			train_tree <T>* c1 = plan(at[D0, _, at.length() - 1], h1, w ? w->children(1) : 0);
+			h = std::max(h0, h1) + 1;
+			book = new train_node <T>(c0, c1, at, opt);
+		}
+		book->cache = opt.cache << 20;
+		book->init = init;
+		if (level.size() <= h) level.resize(h + 1);
+		level[h].push_back(part(at, book));
+		return book;
+	}
+
+//-----------------------------------------------------------------------------
+
+public:
+
+	// finds data interval per dimension, over all shards if distributed
+	train_stream(data_stream <T>& in, const train_options& opt,
+					 task_pool& pool, const file_exchange* ex = 0) :
+		in(in), opt(opt), pool(pool), ex(ex)
+	{
+		msg::in_line(info, "finding data range");
+		range_body range(lo, hi);
+		pass(range);
+		if (ex)
+		{
+			range_io r(lo, hi);
+			ex->put("range", opt.shard, r);
+			lo.init();
+			hi.init();
+			for (size_t i = 0; i < opt.shards; i++)
+				ex->get("range", i, r);
+		}
+		msg::done(info);
+	}
+
+	// untrained codebook on dimension range at, to start from init if any
+	train_tree <T>* book(const size_array& at, const tree <T>* init = 0)
+	{
+		size_t h;
+		return plan(at, h, init);
+	}
+
+	// train all codebooks, one level per pass
+	void operator()()
+	{
+		for (size_t h = 0; h < level.size(); h++)
+		{
+			parts& p = level[h];
+			if (p.empty()) continue;  // all resumed
+			msg::in_line(info, "accumulating level ", h);
+			add_body add(p, pool);
+			pass(add);
+			msg::done(info);
+			fit(p, h);
+		}
+		level.clear();
+	}
+};
+
+//-----------------------------------------------------------------------------
+
+}  // namespace drvq
+
+#endif  // TRAIN_STREAM_HPP
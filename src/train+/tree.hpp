@@ -52,10 +52,79 @@ struct train_tree : public tree <T>
 	virtual const array <lab>& labels() const = 0;
 	virtual const array <array <T> >& centroids() const = 0;
 	virtual void release() = 0;
+	virtual void unlabel() = 0;  // data labels, once read by the parent
+
+	// resume from checkpoint: set centroids, and data labels unless X is
+	// empty
+	virtual void restore(const book& cen, const data& X, const size_array& at) = 0;
+
+	// streaming: accumulate a block of data points, then train on all
+	// points accumulated; children must be trained in between
+	virtual void add(const data& X, const size_array& at) = 0;
+	virtual void fit(const size_array& at, const train_options& opt,
+						  task_pool& pool) = 0;
+
+	// distributed: accumulated statistics are written by workers and added
+	// by the coordinator; the grid of a subtree trained by the coordinator
+	// is read by workers, which only need it to quantize
+	virtual void write_stats(std::ostream& s) const = 0;
+	virtual void read_stats(std::istream& s) = 0;
+	virtual void write_source(std::ostream& s) const = 0;
+	virtual void read_source(std::istream& s) = 0;
 
 	// TODO: remove size_array
 	virtual array_2d <T> dist2(const data&, const size_array&) const = 0;
 	virtual array_2d <T> dist2(const size_array& c) const = 0;
+
+	size_t cache;                  // memory cap of distance table, in bytes
+
+	// pairwise distances between centroids, filled lazily by pair2() with
+	// no lock; safe only because the parent node, trained by one task, is
+	// the sole caller once this subtree is trained
+	mutable array_2d <T> table;
+	const tree <T>* init;          // trained subtree to start from, if any
+
+	train_tree() : cache(0), init(0) { }
+
+	// squared distances of centroids c to all centroids, gathered from a
+	// table of all pairs, computed on first use if it fits in cache bytes;
+	// computed directly otherwise. Valid as long as centroids are fixed
+	array_2d <T> pair2(const size_array& c) const
+	{
+		const size_t K = this->size();
+		if (K * K * sizeof(T) > cache) return dist2(c);
+		if (table.empty()) table = dist2((0, _, K - 1));
+
+		array_2d <T> d(c.length(), K);
+		for (size_t j = 0; j < K; j++)
+			for (size_t i = 0; i < c.length(); i++)
+				d(i, j) = table(c[i], j);
+		return d;
+	}
+
+	void uncache() { table.init(idx(0, 0)); }  // TODO: init()
+
+	// random seed of subtree on dimension range at; independent of the order
+	// in which subtrees are trained
+	static size_t seed(const train_options& opt, const size_array& at)
+	{
+		return mix_seed(opt.seed, at[0], at.length());
+	}
+
+	// terminate after iteration it, where changed of n target bins changed
+	// label and distortion is dist, against last of previous iteration?
+	// With opt.improve > 0, when relative improvement of distortion drops
+	// below it; otherwise, when changes drop below a fraction growing with it
+	static bool converged(const train_options& opt, const size_t it,
+	                      const size_t changed, const size_t n,
+	                      const double dist, double& last)
+	{
+		double ratio = opt.theta * _[it * .01] ->* 2;
+		bool done = opt.improve > 0 ? !(last - dist > opt.improve * last) :
+		                              changed < n * ratio;
+		last = dist;
+		return done;
+	}
 };
 
 //-----------------------------------------------------------------------------
@@ -66,26 +135,125 @@ template <typename T> class train_node;
 
 //-----------------------------------------------------------------------------
 
+// subtree as written by write(), but trainable
+template <typename T>
+train_tree <T>* read_train(std::istream& s)
+{
+	if (ivl::read <char>(s)) return new train_node <T>(s);
+	else                     return new train_leaf <T>(s);
+}
+
+//-----------------------------------------------------------------------------
+
+// checkpoint file of subtree on dimension range at
+inline string
+checkpoint_file(const train_options& opt, const size_array& at)
+{
+	return opt.checkpoint + '/' + to_<string>(at[0]) + '-' +
+		to_<string>(at.length()) + ".bin";
+}
+
+// save trained subtree on dimension range at, along with its centroids, if
+// checkpoints are enabled; written under a temporary name and renamed when
+// complete, so a checkpoint is never partial
+template <typename T>
+void checkpoint(const train_tree <T>* book, const train_options& opt,
+					 const size_array& at)
+{
+	if (opt.checkpoint.empty() || !book) return;
+	const string file = checkpoint_file(opt, at), temp = file + ".part";
+	{
+		std::ofstream s(temp.c_str(), std::ios::binary);
+		msg::require(check, s.is_open(), "cannot write checkpoint " + temp);
+		book->write(s);
+		write_array(book->centroids(), s);
+	}
+	msg::require(check, !std::rename(temp.c_str(), file.c_str()),
+	             "cannot write checkpoint " + file);
+}
+
+// load subtree on dimension range at from its checkpoint, if resuming and
+// it exists; labels data X unless empty
+template <typename T>
+train_tree <T>*
+resume(const array <array <T> >& X, const size_array& at,
+		 const train_options& opt)
+{
+	if (!opt.resume || opt.checkpoint.empty()) return 0;
+	std::ifstream s(checkpoint_file(opt, at).c_str(), std::ios::binary);
+	if (!s.is_open()) return 0;
+	train_tree <T>* book = read_train <T>(s);
+	book->restore(read_array <array <T> >()(s), X, at);
+	book->cache = opt.cache << 20;
+	return book;
+}
+
+// will subtree on dimension range at be loaded from its checkpoint?
+inline bool
+resumable(const size_array& at, const train_options& opt)
+{
+	if (!opt.resume || opt.checkpoint.empty()) return false;
+	std::ifstream s(checkpoint_file(opt, at).c_str(), std::ios::binary);
+	return s.is_open();
+}
+
+//-----------------------------------------------------------------------------
+
 // TODO: remove "at"
 template <typename T>
 train_tree <T>*
 train(const array <array <T> >& X, const size_array& at,
-		const train_options& opt)
+		const train_options& opt, task_pool& pool, const tree <T>* init = 0,
+		array <train_tree <T>*>* leaf = 0)
 
 {
 	// TODO: remove at.empty()
 	if (X.empty() || at.empty() || opt.cap.empty())
 		return 0;
-	if (at.length() == 1)
+	if (at.length() == 1 && leaf && !leaf->empty() && (*leaf)[at[0]])  // in batch
+	{
+		train_tree <T>* book = (*leaf)[at[0]];
+		(*leaf)[at[0]] = 0;  // taken; leaves left over are freed by the caller
+		return book;
+	}
+	if (train_tree <T>* book = resume(X, at, opt))
+		return book;
+	train_tree <T>* book = at.length() == 1 ?
 		// TODO: X[at[0]] -> X[0]
-		return new train_leaf <T> (X[at[0]], opt);
-	else
+		static_cast <train_tree <T>*> (new train_leaf <T> (X[at[0]], opt,
+		                               train_tree <T>::seed(opt, at), init)) :
 		// TODO: X, at -> X
-		return new train_node <T> (X, at, opt);
+		static_cast <train_tree <T>*> (new train_node <T> (X, at, opt, pool, init, leaf));
+	book->cache = opt.cache << 20;
+	checkpoint(book, opt, at);
+	return book;
 }
 
 //-----------------------------------------------------------------------------
 
+// subtree training as a task, to run concurrently with its siblings
+template <typename T>
+struct train_task : public task
+{
+	const array <array <T> >& X;  // data points
+	const size_array at;          // dimension range
+	const train_options& opt;     // training options
+	task_pool& pool;              // training threads
+	const tree <T>* init;         // trained subtree to start from, if any
+	array <train_tree <T>*>* leaf;  // leaf per dimension, if trained in batch
+	train_tree <T>* book;         // output subtree
+
+	train_task(const array <array <T> >& X, const size_array& at,
+				  const train_options& opt, task_pool& pool,
+				  const tree <T>* init = 0,
+				  array <train_tree <T>*>* leaf = 0) :
+		X(X), at(at), opt(opt), pool(pool), init(init), leaf(leaf), book(0) { }
+
+	void run() { book = train(X, at, opt, pool, init, leaf); }
+};
+
+//-----------------------------------------------------------------------------
+
 }  // namespace drvq
 
 #endif  // TRAIN_TREE_HPP
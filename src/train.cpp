@@ -43,6 +43,62 @@ using namespace std;
 
 //-----------------------------------------------------------------------------
 
+// codebooks to start training from, if any
+template <typename T>
+root <T>* load_init(const train_options& opt)
+{
+	if (opt.init.empty()) return 0;
+	msg::in_line(info, "loading initial codebooks...");
+	root <T>* init = root <T>::load(opt.init);
+	msg::require(check, init, "empty initial codebooks");
+	msg::done(info);
+	msg::nl(info);
+	return init;
+}
+
+//-----------------------------------------------------------------------------
+
+// out-of-core training, streaming data from files, possibly distributed
+// over processes each streaming a shard of the files
+void stream_train(const train_options& opt)
+{
+	typedef float T;
+	timer t;
+
+	// data input
+	data_stream <T> in(opt);
+	msg::require(check, in.dims(), "empty training data");
+	msg::require(check, opt.shard < opt.shards, "shard out of range");
+	msg::require(check, opt.shards < 2 || !opt.run.empty(),
+	             "distributed training needs a run id");
+	msg::require(check, opt.shards < 2 || !opt.resume || !opt.checkpoint.empty(),
+	             "distributed resume needs a shared checkpoint directory");
+	in.shard(opt.shard, opt.shards);
+	msg::data(info, in.files(), in.size(), in.dims());
+	msg::nl(info);
+	file_exchange ex(opt.exchange, opt.run, opt.timeout);
+	root <T>* init = load_init <T>(opt);
+
+	// train
+	msg::disp(info, "training codebooks");
+	msg::nl(info);
+	t.tic();
+	task_pool pool(opt.threads);
+	train_root <T>* book =
+		new train_root <T>(in, opt, pool, opt.shards > 1 ? &ex : 0, init);
+	msg::time(info, "total training time", t.toc());
+	msg::nl(info);
+
+	// output, by coordinator only
+	if (opt.shard) return;
+	msg::in_line(info, "saving codebooks...");
+	book->save(opt.book);
+	msg::done(info);
+	msg::nl(info);
+}
+
+//-----------------------------------------------------------------------------
+
 void train(const train_options& opt = train_options())
 {
 	typedef float T;
@@ -58,6 +114,12 @@ void train(const train_options& opt = train_options())
 	msg::capacity(info, opt.cap);
 	msg::nl(info);
 
+	if (opt.stream || opt.shards > 1)
+	{
+		stream_train(opt);
+		return;
+	}
+
 	// data input
 	msg::in_line(info, "loading training data");
 	t.tic();
@@ -73,12 +135,14 @@ void train(const train_options& opt = train_options())
 	normalize(X, opt);
 	msg::done(info);
 	msg::nl(info);
+	root <T>* init = load_init <T>(opt);
 
 	// train
 	msg::disp(info, "training codebooks");
 	msg::nl(info);
 	t.tic();
-	train_root <T>* book = new train_root <T>(X, opt);
+	task_pool pool(opt.threads);
+	train_root <T>* book = new train_root <T>(X, opt, pool, init);
 	msg::time(info, "total training time", t.toc());
 	msg::nl(info);
 
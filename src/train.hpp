@@ -34,6 +34,7 @@
 #include "train+/tree.hpp"
 #include "train+/leaf.hpp"
 #include "train+/node.hpp"
+#include "train+/stream.hpp"
 #include "train+/root.hpp"
 
 #endif  // TRAIN_HPP